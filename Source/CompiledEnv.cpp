@@ -0,0 +1,510 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#include "CompiledEnv.h"
+#include "EnvGen.h"
+
+
+// the closed form of each curve type, the switch is resolved at compile time
+template <EnvCurve::CurveType Type, EnvMath::Accuracy Accuracy>
+static inline float evaluateShape(CompiledEnv::Segment const& segment, const double pos) throw()
+{
+    const float level0 = segment.level0;
+    const float level1 = segment.level1;
+    
+    switch (Type)
+    {
+        case EnvCurve::Linear:
+            return level0 + (level1 - level0) * (float) pos;
+            
+        case EnvCurve::Numerical:
+            return level0 + (level1 - level0) * (1.f - EnvMath::exp((float) pos * segment.curve, Accuracy)) * segment.coefficient;
+            
+        case EnvCurve::Exponential:
+            return level0 * EnvMath::exp((float) pos * segment.coefficient, Accuracy);
+            
+        case EnvCurve::Sine:
+            return level0 + (level1 - level0) * (0.5f - 0.5f * std::cos(MathConstants<float>::pi * (float) pos));
+            
+        case EnvCurve::Welch:
+            if (level0 < level1)
+                return level0 + (level1 - level0) * std::sin(MathConstants<float>::halfPi * (float) pos);
+            
+            return level1 + (level0 - level1) * std::cos(MathConstants<float>::halfPi * (float) pos);
+            
+        default:
+            // Empty, Step or zero-length segments
+            return level1;
+    }
+}
+
+template <EnvCurve::CurveType Type, EnvMath::Accuracy Accuracy>
+static float evaluateSegment(CompiledEnv::Segment const& segment, const double pos)
+{
+    return evaluateShape<Type, Accuracy>(segment, pos);
+}
+
+template <EnvCurve::CurveType Type, EnvMath::Accuracy Accuracy>
+static void evaluateSegmentTimes(CompiledEnv::Segment const& segment, const double* times, float* output, const int numTimes)
+{
+    const double startTime = segment.startTime;
+    const double reciprocalDuration = segment.reciprocalDuration;
+    
+    for (int i = 0; i < numTimes; ++i)
+        output[i] = evaluateShape<Type, Accuracy>(segment, (times[i] - startTime) * reciprocalDuration);
+}
+
+template <EnvMath::Accuracy Accuracy>
+static void selectEvaluators(CompiledEnv::Segment& segment, const EnvCurve::CurveType type) throw()
+{
+    switch (type)
+    {
+        case EnvCurve::Linear:
+            segment.evaluator = evaluateSegment<EnvCurve::Linear, Accuracy>;
+            segment.blockEvaluator = evaluateSegmentTimes<EnvCurve::Linear, Accuracy>;
+            break;
+            
+        case EnvCurve::Numerical:
+            segment.evaluator = evaluateSegment<EnvCurve::Numerical, Accuracy>;
+            segment.blockEvaluator = evaluateSegmentTimes<EnvCurve::Numerical, Accuracy>;
+            break;
+            
+        case EnvCurve::Exponential:
+            segment.evaluator = evaluateSegment<EnvCurve::Exponential, Accuracy>;
+            segment.blockEvaluator = evaluateSegmentTimes<EnvCurve::Exponential, Accuracy>;
+            break;
+            
+        case EnvCurve::Sine:
+            segment.evaluator = evaluateSegment<EnvCurve::Sine, Accuracy>;
+            segment.blockEvaluator = evaluateSegmentTimes<EnvCurve::Sine, Accuracy>;
+            break;
+            
+        case EnvCurve::Welch:
+            segment.evaluator = evaluateSegment<EnvCurve::Welch, Accuracy>;
+            segment.blockEvaluator = evaluateSegmentTimes<EnvCurve::Welch, Accuracy>;
+            break;
+            
+        default:
+            segment.evaluator = evaluateSegment<EnvCurve::Step, Accuracy>;
+            segment.blockEvaluator = evaluateSegmentTimes<EnvCurve::Step, Accuracy>;
+            break;
+    }
+}
+
+void CompiledEnv::Segment::prepare(const double newStartTime,
+                                   const double newEndTime,
+                                   const float newLevel0,
+                                   const float newLevel1,
+                                   EnvCurve const& newCurve,
+                                   const EnvMath::Accuracy newAccuracy) throw()
+{
+    startTime = newStartTime;
+    endTime = newEndTime;
+    reciprocalDuration = endTime > startTime ? 1.0 / (endTime - startTime) : 0.0;
+    level0 = newLevel0;
+    level1 = newLevel1;
+    type = newCurve.getType();
+    curve = newCurve.getCurve();
+    coefficient = 0.f;
+    
+    if (type == EnvCurve::Numerical)
+    {
+        if (std::abs(curve) <= 0.001f)
+            type = EnvCurve::Linear;
+        else
+            coefficient = 1.f / (1.f - std::exp(curve));
+    }
+    else if (type == EnvCurve::Exponential && EnvCurve::canBeExponential(level0, level1))
+    {
+        coefficient = std::log(level1 / level0);
+    }
+    
+    setAccuracy(newAccuracy);
+}
+
+void CompiledEnv::Segment::setAccuracy(const EnvMath::Accuracy newAccuracy) throw()
+{
+    EnvCurve::CurveType evaluatorType = type;
+    accuracy = newAccuracy;
+    
+    if (reciprocalDuration == 0.0)
+        evaluatorType = EnvCurve::Step;
+    else if (type == EnvCurve::Exponential && ! EnvCurve::canBeExponential(level0, level1))
+        evaluatorType = EnvCurve::Linear;
+    
+    if (accuracy == EnvMath::Fast)
+        selectEvaluators<EnvMath::Fast>(*this, evaluatorType);
+    else
+        selectEvaluators<EnvMath::Exact>(*this, evaluatorType);
+}
+
+float CompiledEnv::Segment::evaluate(const double pos, EnvTransform const& transform) const throw()
+{
+    // every shape except Exponential is an affine function of its two levels
+    if (type == EnvCurve::Exponential && transform.levelBias != 0.0 && reciprocalDuration != 0.0)
+    {
+        const float biasedLevel0 = (float) transform.level(level0);
+        const float biasedLevel1 = (float) transform.level(level1);
+        
+        if (! EnvCurve::canBeExponential(biasedLevel0, biasedLevel1))
+            return biasedLevel0 + (biasedLevel1 - biasedLevel0) * (float) pos;
+        
+        return biasedLevel0 * EnvMath::exp((float) pos * std::log(biasedLevel1 / biasedLevel0), accuracy);
+    }
+    
+    return (float) transform.level(evaluate(pos));
+}
+
+CompiledEnv::CompiledEnv() throw()
+:   firstLevel_(0.f),
+    lastLevel_(0.f),
+    duration_(0.0),
+    sampleRate_(0.0),
+    releaseNode_(-1),
+    loopNode_(-1),
+    accuracy_(EnvMath::Exact)
+{
+}
+
+CompiledEnv::CompiledEnv(Env const& env) throw()
+:   CompiledEnv()
+{
+    compile(env);
+}
+
+CompiledEnv::CompiledEnv(EnvView const& env) throw()
+:   CompiledEnv()
+{
+    compile(env);
+}
+
+void CompiledEnv::compile(Env const& env) throw()
+{
+    compile(EnvView(env));
+}
+
+void CompiledEnv::compile(EnvView const& env) throw()
+{
+    const auto levels = env.getLevels();
+    const auto times = env.getTimes();
+    const int numLevels = levels.size();
+    const int numSegments = jmin(times.size(), jmax(0, numLevels - 1));
+    
+    assert(times.size() == numLevels - 1);
+    
+    segments_.resize(numSegments);
+    endTimes_.resize(numSegments);
+    
+    firstLevel_ = numLevels > 0 ? (float) levels[0] : 0.f;
+    lastLevel_ = numLevels > 0 ? (float) levels[numSegments] : 0.f;
+    releaseNode_ = env.getReleaseNode();
+    loopNode_ = env.getLoopNode();
+    
+    double time = 0.0;
+    
+    for (int i = 0; i < numSegments; ++i)
+    {
+        assert(times[i] >= 0.0);
+        
+        const double startTime = time;
+        time += times[i];
+        
+        segments_[i].prepare(startTime, time, (float) levels[i], (float) levels[i + 1], env.getCurve(i), accuracy_);
+        
+        endTimes_[i] = time;
+    }
+    
+    duration_ = time;
+    updateEndSamples();
+}
+
+void CompiledEnv::setSampleRate(const double sampleRate) throw()
+{
+    assert(sampleRate > 0.0);
+    sampleRate_ = sampleRate;
+    updateEndSamples();
+}
+
+void CompiledEnv::updateEndSamples() throw()
+{
+    if (sampleRate_ <= 0.0)
+        return;
+    
+    const int numSegments = getNumSegments();
+    endSamples_.resize(numSegments);
+    
+    for (int i = 0; i < numSegments; ++i)
+        endSamples_[i] = (int64) std::llround(endTimes_[i] * sampleRate_);
+}
+
+int CompiledEnv::findSegment(const double time) const throw()
+{
+    if (time <= 0.0)
+        return -1;
+    
+    return (int) (std::lower_bound(endTimes_.begin(), endTimes_.end(), time) - endTimes_.begin());
+}
+
+int CompiledEnv::findSegment(const double time, const int hint) const throw()
+{
+    const int numSegments = getNumSegments();
+    
+    if (hint < 0 || hint >= numSegments || time <= segments_[hint].startTime)
+        return findSegment(time);
+    
+    // gallop forwards from the hint, the answer is then in [low, low + step]
+    int low = hint;
+    int step = 1;
+    
+    while (low + step < numSegments && endTimes_[low + step] < time)
+    {
+        low += step;
+        step *= 2;
+    }
+    
+    const int high = jmin(low + step + 1, numSegments);
+    return (int) (std::lower_bound(endTimes_.begin() + low, endTimes_.begin() + high, time) - endTimes_.begin());
+}
+
+float CompiledEnv::lookupSegment(const int segmentIndex, const double time, EnvTransform const& transform) const throw()
+{
+    if (segmentIndex >= getNumSegments())
+        return (float) transform.level(lastLevel_);
+    
+    const Segment& segment = segments_[segmentIndex];
+    return segment.evaluate((time - segment.startTime) * segment.reciprocalDuration, transform);
+}
+
+float CompiledEnv::lookup(const double time, EnvTransform const& transform) const throw()
+{
+    int segmentHint = -1;
+    return lookup(time, segmentHint, transform);
+}
+
+float CompiledEnv::lookup(const double time, int& segmentHint, EnvTransform const& transform) const throw()
+{
+    const double envTime = time / transform.timeScale;
+    
+    if (segments_.empty() || envTime <= 0.0)
+        return (float) transform.level(firstLevel_);
+    
+    segmentHint = findSegment(envTime, segmentHint);
+    return lookupSegment(segmentHint, envTime, transform);
+}
+
+void CompiledEnv::lookup(const double* times, float* output, const int numTimes) const throw()
+{
+    const int numSegments = getNumSegments();
+    int segmentIndex = -1;
+    int i = 0;
+    
+    while (i < numTimes)
+    {
+        const double time = times[i];
+        
+        if (numSegments == 0 || time <= 0.0)
+        {
+            output[i++] = firstLevel_;
+            continue;
+        }
+        
+        segmentIndex = findSegment(time, segmentIndex);
+        
+        if (segmentIndex >= numSegments)
+        {
+            output[i++] = lastLevel_;
+            continue;
+        }
+        
+        // the run of times in the same segment
+        const Segment& segment = segments_[segmentIndex];
+        int end = i + 1;
+        
+        while (end < numTimes && times[end] > segment.startTime && times[end] <= segment.endTime)
+            ++end;
+        
+        segment.evaluate(times + i, output + i, end - i);
+        i = end;
+    }
+}
+
+void CompiledEnv::setAccuracy(const EnvMath::Accuracy accuracy) throw()
+{
+    accuracy_ = accuracy;
+    
+    for (auto& segment : segments_)
+        segment.setAccuracy(accuracy);
+}
+
+void CompiledEnv::render(float* output, const int numSamples, const double startTime, const double timeIncrement,
+                         EnvTransform const& transform) const throw()
+{
+    assert(timeIncrement > 0.0);
+    
+    // render the untransformed envelope at the scaled times
+    const double envStartTime = startTime / transform.timeScale;
+    const double envTimeIncrement = timeIncrement / transform.timeScale;
+    
+    const int numSegments = getNumSegments();
+    int segmentIndex = -1;
+    int i = 0;
+    
+    while (i < numSamples)
+    {
+        const double time = envStartTime + i * envTimeIncrement;
+        const int remaining = numSamples - i;
+        
+        if (numSegments == 0 || time <= 0.0)
+        {
+            const int count = numSegments == 0 ? remaining
+                                               : jlimit(1, remaining, (int) std::floor(-envStartTime / envTimeIncrement) + 1 - i);
+            FloatVectorOperations::fill(output + i, (float) transform.level(firstLevel_), count);
+            i += count;
+            continue;
+        }
+        
+        segmentIndex = findSegment(time, segmentIndex);
+        
+        if (segmentIndex >= numSegments)
+        {
+            FloatVectorOperations::fill(output + i, (float) transform.level(lastLevel_), remaining);
+            break;
+        }
+        
+        const Segment& segment = segments_[segmentIndex];
+        const int64 last = (int64) std::floor((segment.endTime - envStartTime) / envTimeIncrement);
+        const int count = (int) jlimit((int64) 1, (int64) remaining, last - i + 1);
+        
+        if (segment.reciprocalDuration == 0.0)
+        {
+            FloatVectorOperations::fill(output + i, (float) transform.level(segment.level1), count);
+        }
+        else
+        {
+            EnvGenSegment::render(output + i, count,
+                                  transform.level(segment.level0), transform.level(segment.level1),
+                                  segment.type, segment.curve,
+                                  (time - segment.startTime) * segment.reciprocalDuration,
+                                  envTimeIncrement * segment.reciprocalDuration);
+        }
+        
+        i += count;
+    }
+}
+
+int CompiledEnv::findSegmentAtSample(const int64 sample, const int hint) const throw()
+{
+    assert(endSamples_.size() == segments_.size());
+    
+    if (sample < 0)
+        return -1;
+    
+    auto first = endSamples_.begin();
+    
+    if (hint >= 0 && hint < getNumSegments() && getStartSample(hint) <= sample)
+    {
+        if (sample < endSamples_[hint])
+            return hint;
+        
+        first += hint + 1;
+    }
+    
+    return (int) (std::upper_bound(first, endSamples_.end(), sample) - endSamples_.begin());
+}
+
+float CompiledEnv::lookupSample(const int64 sample, const double fraction, int& segmentHint) const throw()
+{
+    if (segments_.empty() || sample < 0)
+        return firstLevel_;
+    
+    segmentHint = findSegmentAtSample(sample, segmentHint);
+    
+    if (segmentHint >= getNumSegments())
+        return lastLevel_;
+    
+    // the subtraction is exact so this is as precise at the end of a long envelope as at the start
+    const int64 startSample = getStartSample(segmentHint);
+    const double length = (double) (endSamples_[segmentHint] - startSample);
+    return segments_[segmentHint].evaluate(((double) (sample - startSample) + fraction) / length);
+}
+
+float CompiledEnv::lookupSample(const int64 sample, const double fraction) const throw()
+{
+    int segmentHint = -1;
+    return lookupSample(sample, fraction, segmentHint);
+}
+
+void CompiledEnv::renderSamples(float* output, const int numSamples, const int64 startSample) const throw()
+{
+    const int numSegments = getNumSegments();
+    int segmentIndex = -1;
+    int i = 0;
+    
+    while (i < numSamples)
+    {
+        const int64 sample = startSample + i;
+        const int remaining = numSamples - i;
+        
+        if (numSegments == 0 || sample < 0)
+        {
+            const int count = numSegments == 0 ? remaining : (int) jmin((int64) remaining, -sample);
+            FloatVectorOperations::fill(output + i, firstLevel_, count);
+            i += count;
+            continue;
+        }
+        
+        segmentIndex = findSegmentAtSample(sample, segmentIndex);
+        
+        if (segmentIndex >= numSegments)
+        {
+            FloatVectorOperations::fill(output + i, lastLevel_, remaining);
+            break;
+        }
+        
+        const Segment& segment = segments_[segmentIndex];
+        const int64 segmentStart = getStartSample(segmentIndex);
+        const int64 segmentEnd = endSamples_[segmentIndex];
+        const double reciprocalLength = 1.0 / (double) (segmentEnd - segmentStart);
+        const int count = (int) jmin((int64) remaining, segmentEnd - sample);
+        
+        EnvGenSegment::render(output + i, count,
+                              segment.level0, segment.level1, segment.type, segment.curve,
+                              (double) (sample - segmentStart) * reciprocalLength,
+                              reciprocalLength);
+        i += count;
+    }
+}
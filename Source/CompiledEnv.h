@@ -0,0 +1,256 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#pragma once
+
+#include "Env.h"
+
+/** A read-only, pre-processed form of an Env for fast repeated evaluation.
+ 
+ Env stores its times as segment durations so finding the segment for a given
+ time means summing durations from the start. A CompiledEnv is built once from
+ an Env and stores the cumulative (prefix-summed) breakpoint times in double
+ precision along with per-segment coefficients so that lookup() is a binary
+ search followed by a single segment evaluation.
+ 
+ For monotonically increasing times (e.g., when rendering) use the hinted
+ version of lookup() which resumes the search from the last segment found.
+ 
+ Like Env::lookup() this ignores the loopNode and releaseNode if they are set.
+ 
+ @ingroup EnvUGens
+ @see Env */
+class CompiledEnv
+{
+public:
+    /** A single pre-processed segment of a CompiledEnv.
+     Each segment holds pointers to evaluators specialised for its curve type and
+     the accuracy of the CompiledEnv so evaluating it does not check its type. */
+    struct Segment
+    {
+        typedef float (*Evaluator) (Segment const& segment, const double pos);
+        typedef void (*BlockEvaluator) (Segment const& segment, const double* times, float* output, const int numTimes);
+        
+        double startTime;           ///< The cumulative time at the start of the segment.
+        double endTime;             ///< The cumulative time at the end of the segment.
+        double reciprocalDuration;  ///< 1 / (endTime - startTime) or 0 for zero-length segments.
+        float level0;               ///< The level at the start of the segment.
+        float level1;               ///< The level at the end of the segment.
+        EnvCurve::CurveType type;   ///< The curve type, Numerical curves close to zero are stored as Linear.
+        float curve;                ///< The curve value for Numerical segments.
+        float coefficient;          ///< For Numerical segments 1 / (1 - exp(curve)), for Exponential segments log(level1 / level0).
+        Evaluator evaluator;        ///< Evaluates one position, see evaluate().
+        BlockEvaluator blockEvaluator; ///< Evaluates many times, see evaluate().
+        EnvMath::Accuracy accuracy; ///< The accuracy the evaluators were chosen for.
+        
+        /** Sets up the segment and its evaluators.
+         @param startTime   The cumulative time at the start of the segment.
+         @param endTime     The cumulative time at the end of the segment.
+         @param level0      The level at the start of the segment.
+         @param level1      The level at the end of the segment.
+         @param curve       The curve of the segment.
+         @param accuracy    Whether Numerical and Exponential curves use std::exp() or EnvMath::fastExp(). */
+        void prepare(const double startTime,
+                     const double endTime,
+                     const float level0,
+                     const float level1,
+                     EnvCurve const& curve,
+                     const EnvMath::Accuracy accuracy) throw();
+        
+        /** Chooses the evaluators for the curve type and an accuracy. */
+        void setAccuracy(const EnvMath::Accuracy accuracy) throw();
+        
+        /** Get the level at a position within the segment.
+         @param pos         The normalised position, 0 at the start and 1 at the end.
+         @return            The level at that position. */
+        inline float evaluate(const double pos) const throw()   { return evaluator(*this, pos); }
+        
+        /** Get the levels at several times within the segment.
+         This is a loop specialised for the curve type with no per-sample checks.
+         @param times       The times, these must all be in the segment.
+         @param output      The buffer to write the levels to.
+         @param numTimes    The number of times. */
+        inline void evaluate(const double* times, float* output, const int numTimes) const throw()
+        {
+            blockEvaluator(*this, times, output, numTimes);
+        }
+        
+        /** Get the level at a position within the segment with its levels transformed. */
+        float evaluate(const double pos, EnvTransform const& transform) const throw();
+    };
+    
+    /** Creates an empty CompiledEnv which always returns 0. */
+    CompiledEnv() throw();
+    
+    /** Creates a CompiledEnv from an Env. */
+    CompiledEnv(Env const& env) throw();
+    
+    /** Creates a CompiledEnv from an envelope stored elsewhere, e.g., in an EnvBank. */
+    CompiledEnv(EnvView const& env) throw();
+    
+    /** Rebuilds this CompiledEnv from an Env.
+     This reuses the existing storage if it is large enough. */
+    void compile(Env const& env) throw();
+    
+    /** Rebuilds this CompiledEnv from an envelope stored elsewhere.
+     This reuses the existing storage if it is large enough. */
+    void compile(EnvView const& env) throw();
+    
+    inline int getNumSegments() const throw()                     { return (int) segments_.size(); }
+    inline const Segment& getSegment(const int index) const throw() { return segments_[index]; }
+    inline const double* getEndTimes() const throw()              { return endTimes_.data(); }
+    inline float getFirstLevel() const throw()                    { return firstLevel_; }
+    inline float getLastLevel() const throw()                     { return lastLevel_; }
+    inline int getReleaseNode() const throw()                     { return releaseNode_; }
+    inline int getLoopNode() const throw()                        { return loopNode_; }
+    
+    /** Sets how precisely lookup() and lookupSample() evaluate curves.
+     EnvMath::Fast replaces the one exp() per lookup in Numerical and Exponential
+     segments with EnvMath::fastExp(), the exp() of the curve itself is always
+     computed exactly once per segment by compile(). This is kept if the envelope
+     is recompiled, render() and renderSamples() do not call exp() per sample so
+     they are not affected. */
+    void setAccuracy(const EnvMath::Accuracy accuracy) throw();
+    
+    inline EnvMath::Accuracy getAccuracy() const throw()          { return accuracy_; }
+    
+    /** Returns the sum the time values in the envelope. */
+    inline double duration() const throw()                        { return duration_; }
+    
+    /** Find the segment which contains a given time.
+     @param time    The time to search for.
+     @return        The index of the segment, -1 if the time is at or before the
+                    start or getNumSegments() if it is after the end. */
+    int findSegment(const double time) const throw();
+    
+    /** Find the segment which contains a given time starting from a previous result.
+     This is O(1) when the time is in the same or the next segment and falls back
+     to a galloping search otherwise.
+     @param time    The time to search for.
+     @param hint    A previous result of findSegment().
+     @return        The same as findSegment(time). */
+    int findSegment(const double time, const int hint) const throw();
+    
+    /** Get the level of the envelope at a given time.
+     @param time            The time to look up.
+     @param transform       A scaling applied to the levels and times as they are used. */
+    float lookup(const double time, EnvTransform const& transform = EnvTransform()) const throw();
+    
+    /** Get the level of the envelope at a given time.
+     @param time            The time to look up.
+     @param segmentHint     The segment found by the previous call, this is updated
+                            with the segment found by this call. Initialise this to -1.
+     @param transform       A scaling applied to the levels and times as they are used. */
+    float lookup(const double time, int& segmentHint, EnvTransform const& transform = EnvTransform()) const throw();
+    
+    /** Get the levels of the envelope at many times.
+     The times are split into runs in the same segment and each run is evaluated by
+     the segment's specialised evaluator. Sorted times take one pass over the segments,
+     unsorted times still work but each jump backwards needs a binary search.
+     @param times       The times to look up.
+     @param output      The buffer to write the levels to.
+     @param numTimes    The number of times. */
+    void lookup(const double* times, float* output, const int numTimes) const throw();
+    
+    /** Writes the envelope into a buffer at regularly spaced times.
+     The buffer is only split at segment boundaries, within each segment this uses
+     the vectorised incremental recurrences in EnvGenSegment rather than evaluating
+     each sample from scratch.
+     @param output          The buffer to write to.
+     @param numSamples      The number of samples to write.
+     @param startTime       The time of the first sample.
+     @param timeIncrement   The time between samples, this must be greater than zero.
+     @param transform       A scaling applied to the levels and times as they are used. */
+    void render(float* output, const int numSamples, const double startTime, const double timeIncrement,
+                EnvTransform const& transform = EnvTransform()) const throw();
+    
+    /// @name Sample-accurate evaluation
+    /// @{
+    
+    /** Precomputes the segment boundaries as whole numbers of samples.
+     The boundaries are rounded from the cumulative times, as EnvGen does, so positions
+     can then be given as 64-bit sample counts which do not lose precision or drift
+     however long the envelope is. This is kept if the envelope is recompiled. */
+    void setSampleRate(const double sampleRate) throw();
+    
+    inline double getSampleRate() const throw()                   { return sampleRate_; }
+    
+    /** Returns the first sample of a segment, setSampleRate() must have been called. */
+    inline int64 getStartSample(const int index) const throw()    { return index > 0 ? endSamples_[index - 1] : 0; }
+    
+    /** Returns the sample after the last sample of a segment, setSampleRate() must have been called. */
+    inline int64 getEndSample(const int index) const throw()      { return endSamples_[index]; }
+    
+    /** Find the segment which contains a given sample.
+     @param sample  The sample to search for.
+     @param hint    A previous result or -1.
+     @return        The index of the segment, -1 if the sample is before the start
+                    or getNumSegments() if it is at or after the end. */
+    int findSegmentAtSample(const int64 sample, const int hint = -1) const throw();
+    
+    /** Get the level of the envelope at a sample position.
+     @param sample          The whole number of samples from the start of the envelope.
+     @param fraction        The fraction of a sample after that, from 0 up to 1.
+     @param segmentHint     The segment found by the previous call, this is updated
+                            with the segment found by this call. Initialise this to -1. */
+    float lookupSample(const int64 sample, const double fraction, int& segmentHint) const throw();
+    
+    /** Get the level of the envelope at a sample position. */
+    float lookupSample(const int64 sample, const double fraction = 0.0) const throw();
+    
+    /** Writes the envelope into a buffer starting at a given sample.
+     This gives the same result as EnvGen (ignoring the release and loop nodes) from
+     any starting sample. setSampleRate() must have been called. */
+    void renderSamples(float* output, const int numSamples, const int64 startSample) const throw();
+    
+    /// @}
+    
+private:
+    float lookupSegment(const int segmentIndex, const double time, EnvTransform const& transform) const throw();
+    void updateEndSamples() throw();
+    
+    std::vector<Segment> segments_;
+    std::vector<double> endTimes_;
+    std::vector<int64> endSamples_;
+    float firstLevel_;
+    float lastLevel_;
+    double duration_;
+    double sampleRate_;
+    int releaseNode_;
+    int loopNode_;
+    EnvMath::Accuracy accuracy_;
+};
@@ -40,90 +40,494 @@
 
 
 #include "Env.h"
+#include "EnvGen.h"
 
+#include <cstring>
+#include <new>
+
+
+Env::Env(std::initializer_list<double> levels,
+         std::initializer_list<double> times,
+         std::initializer_list<EnvCurve> curves,
+         const int releaseNode,
+         const int loopNode) throw()
+:	releaseNode_(releaseNode),
+	loopNode_(loopNode),
+    heapStorageSize_(0)
+{
+    initialise(levels.begin(), (int) levels.size(),
+               times.begin(), (int) times.size(),
+               curves.begin(), (int) curves.size());
+}
 
 Env::Env(Buffer const& levels,
          Buffer const& times,
          EnvCurveList const& curves,
          const int releaseNode,
          const int loopNode) throw()
-:	levels_(levels),
-	times_(times),
-	curves_(curves),
-	releaseNode_(releaseNode),
-	loopNode_(loopNode)
+:	releaseNode_(releaseNode),
+	loopNode_(loopNode),
+    heapStorageSize_(0)
 {
+    initialise(levels.data(), (int) levels.size(),
+               times.data(), (int) times.size(),
+               curves.data(), (int) curves.size());
 }
 
+Env::Env(const int numSegments,
+         const int releaseNode,
+         const int loopNode) throw()
+:	releaseNode_(releaseNode),
+	loopNode_(loopNode),
+    heapStorageSize_(0)
+{
+    assert(numSegments >= 0);
+    
+    allocate(numSegments + 1, numSegments);
+    
+    std::fill(levels_, levels_ + numLevels_, 0.0);
+    std::fill(times_, times_ + numTimes_, 0.0);
+    
+    for (int i = 0; i < numTimes_; ++i)
+        new (curves_ + i) EnvCurve(EnvCurve::Linear);
+}
 
-double Env::duration() const throw()
+Env::Env(EnvView const& view) throw()
+:	releaseNode_(view.getReleaseNode()),
+	loopNode_(view.getLoopNode()),
+    heapStorageSize_(0)
 {
-    double sum = 0.0;
+    initialise(view.getLevels().data(), view.getLevels().size(),
+               view.getTimes().data(), view.getTimes().size(),
+               view.getCurves().data(), view.getCurves().size());
+}
+
+Env::Env(Env const& other) throw()
+:   heapStorageSize_(0)
+{
+    copyFrom(other);
+}
+
+Env::Env(Env&& other) throw()
+:   heapStorageSize_(0)
+{
+    moveFrom(other);
+}
+
+Env& Env::operator= (Env const& other) throw()
+{
+    if (this != &other)
+        copyFrom(other);
     
-    for (auto time : times_)
-        sum += time;
+    return *this;
+}
+
+Env& Env::operator= (Env&& other) throw()
+{
+    if (this != &other)
+        moveFrom(other);
     
-    return sum;
+    return *this;
 }
 
-Env Env::levelScale(const double scale) const throw()
+size_t Env::getStorageSize(const int numLevels, const int numTimes) throw()
 {
-    auto newLevels = levels_;
+    static_assert(std::is_trivially_copyable<EnvCurve>::value,
+                  "EnvCurve is copied with memcpy");
+    static_assert(alignof(EnvCurve) <= alignof(double),
+                  "EnvCurve is stored after the doubles");
     
-    for (auto& level : newLevels)
-        level *= scale;
+    return (numLevels + numTimes) * sizeof(double) + numTimes * sizeof(EnvCurve);
+}
 
-	return Env(newLevels,
-			   times_,
-			   curves_,
-			   releaseNode_,
-			   loopNode_);
+void Env::allocate(const int numLevels, const int numTimes) throw()
+{
+    const size_t size = getStorageSize(numLevels, numTimes);
+    char* storage = inlineStorage_;
+    
+    if (size > sizeof(inlineStorage_))
+    {
+        // keep any existing heap block if it is big enough so assigning an Env
+        // of the same size again doesn't allocate
+        if (size > heapStorageSize_)
+        {
+            heapStorage_.reset(new char[size]);
+            heapStorageSize_ = size;
+        }
+        
+        storage = heapStorage_.get();
+    }
+    
+    levels_ = reinterpret_cast<double*>(storage);
+    times_ = levels_ + numLevels;
+    curves_ = reinterpret_cast<EnvCurve*>(times_ + numTimes);
+    numLevels_ = numLevels;
+    numTimes_ = numTimes;
 }
 
-Env Env::levelBias(const double bias) const throw()
+void Env::initialise(const double* levels, const int numLevels,
+                     const double* times, const int numTimes,
+                     const EnvCurve* curves, const int numCurves) throw()
 {
-    auto newLevels = levels_;
+    assert(numLevels == (numTimes + 1));
     
-    for (auto& level : newLevels)
-        level += bias;
+    allocate(numLevels, numTimes);
+    
+    std::copy(levels, levels + numLevels, levels_);
+    std::copy(times, times + numTimes, times_);
+    
+    for (int i = 0; i < numTimes; ++i)
+        new (curves_ + i) EnvCurve(numCurves > 0 ? curves[i % numCurves] : EnvCurve(EnvCurve::Linear));
+}
 
-    return Env(newLevels,
-               times_,
-               curves_,
-               releaseNode_,
-               loopNode_);
+void Env::copyFrom(Env const& other) throw()
+{
+    allocate(other.numLevels_, other.numTimes_);
+    std::memcpy(levels_, other.levels_, getStorageSize(numLevels_, numTimes_));
+    releaseNode_ = other.releaseNode_;
+    loopNode_ = other.loopNode_;
 }
 
-Env Env::timeScale(const double scale) const throw()
+void Env::moveFrom(Env& other) throw()
 {
-	assert(scale > 0.0);
+    if (other.levels_ != reinterpret_cast<double*>(other.inlineStorage_))
+    {
+        // large envelopes: just take the other heap block
+        heapStorage_ = std::move(other.heapStorage_);
+        heapStorageSize_ = other.heapStorageSize_;
+        levels_ = other.levels_;
+        times_ = other.times_;
+        curves_ = other.curves_;
+        numLevels_ = other.numLevels_;
+        numTimes_ = other.numTimes_;
+        releaseNode_ = other.releaseNode_;
+        loopNode_ = other.loopNode_;
+        
+        other.heapStorageSize_ = 0;
+        other.allocate(0, 0);
+    }
+    else
+    {
+        copyFrom(other);
+    }
+}
+
+EnvCurve const& Env::getCurve(const int segment) const throw()
+{
+    assert(segment >= 0 && segment < numTimes_);
+    
+    return curves_[segment];
+}
+
+double Env::duration() const throw()
+{
+    return EnvView(*this).duration();
+}
+
+Env& Env::scaleLevels(const double scale) throw()
+{
+    for (auto& level : getLevels())
+        level *= scale;
+    
+    return *this;
+}
+
+Env& Env::biasLevels(const double bias) throw()
+{
+    for (auto& level : getLevels())
+        level += bias;
     
-    auto newTimes = times_;
+    return *this;
+}
+
+Env& Env::scaleTimes(const double scale) throw()
+{
+	assert(scale > 0.0);
     
-    for (auto& time : newTimes)
+    for (auto& time : getTimes())
         time *= scale;
-	
-    return Env(levels_,
-               newTimes,
-               curves_,
-               releaseNode_,
-               loopNode_);
+    
+    return *this;
+}
+
+Env Env::levelScale(const double scale) const& throw()
+{
+    return Env(*this).scaleLevels(scale);
+}
+
+Env Env::levelScale(const double scale) && throw()
+{
+    return std::move(scaleLevels(scale));
 }
 
+Env Env::levelBias(const double bias) const& throw()
+{
+    return Env(*this).biasLevels(bias);
+}
+
+Env Env::levelBias(const double bias) && throw()
+{
+    return std::move(biasLevels(bias));
+}
 
-float Env::lookup(float time) const throw()
+Env Env::timeScale(const double scale) const& throw()
 {
-    const int numTimes = (int) times_.size();
-    const int numLevels = (int) levels_.size();
+    return Env(*this).scaleTimes(scale);
+}
+
+Env Env::timeScale(const double scale) && throw()
+{
+    return std::move(scaleTimes(scale));
+}
+
+
+float Env::lookup(float time, EnvTransform const& transform, const EnvMath::Accuracy accuracy) const throw()
+{
+    return EnvView(*this).lookup(time, transform, accuracy);
+}
+
+void Env::lookupMany(const float* times, float* output, const int count) const throw()
+{
+    EnvView(*this).lookupMany(times, output, count);
+}
+
+void Env::render(float* output, const int numSamples, const double sampleRate, const double startTime,
+                 EnvTransform const& transform) const throw()
+{
+    EnvView(*this).render(output, numSamples, sampleRate, startTime, transform);
+}
+
+EnvPolyline Env::toPolyline(const double tolerance, const double xScale, const double yScale) const throw()
+{
+    return EnvView(*this).toPolyline(tolerance, xScale, yScale);
+}
+
+/** Subdivides [pos0, pos1] of a segment until the midpoint of the curve is within
+ tolerance of the chord. The curve must be convex or concave over the range, then
+ the distance from the chord is concave and never more than twice that at the midpoint. */
+static void flattenCurve(EnvPolyline& polyline, EnvCurve const& curve,
+                         const double time0, const double timeRange,
+                         const float level0, const float level1,
+                         const double pos0, const double y0,
+                         const double pos1, const double y1,
+                         const double tolerance, const double xScale, const double yScale,
+                         const int depth) throw()
+{
+    const double posMid = (pos0 + pos1) * 0.5;
+    const double yMid = curve.interpolate((float) posMid, level0, level1);
+    
+    // the scaled distance from the chord, the midpoint of the curve is directly above or below the chord's
+    const double dx = (pos1 - pos0) * timeRange * xScale;
+    const double dy = (y1 - y0) * yScale;
+    const double chordLength = std::sqrt(dx * dx + dy * dy);
+    const double error = std::abs(yMid - (y0 + y1) * 0.5) * yScale * (chordLength > 0.0 ? std::abs(dx) / chordLength : 1.0);
+    
+    if(depth > 0 && error > tolerance * 0.5)
+    {
+        flattenCurve(polyline, curve, time0, timeRange, level0, level1, pos0, y0, posMid, yMid, tolerance, xScale, yScale, depth - 1);
+        flattenCurve(polyline, curve, time0, timeRange, level0, level1, posMid, yMid, pos1, y1, tolerance, xScale, yScale, depth - 1);
+    }
+    else
+    {
+        polyline.push_back(Point<double>(time0 + pos1 * timeRange, y1));
+    }
+}
+
+void Env::appendSegmentToPolyline(EnvPolyline& polyline,
+                                  const double time0, const double level0,
+                                  const double time1, const double level1,
+                                  EnvCurve const& curve,
+                                  const double tolerance, const double xScale, const double yScale) throw()
+{
+    assert(tolerance > 0.0);
+    
+    // limits the points per segment to 2^maxDepth however far it is zoomed in
+    const int maxDepth = 12;
+    
+    const double timeRange = time1 - time0;
+    const float l0 = (float) level0;
+    const float l1 = (float) level1;
+    
+    switch(curve.getType())
+    {
+        case EnvCurve::Linear:
+            break;
+            
+        case EnvCurve::Step:
+        case EnvCurve::Empty:
+        {
+            polyline.push_back(Point<double>(time0, level1));
+        } break;
+            
+        case EnvCurve::Sine:
+        {
+            // split at the point of inflection so each half is convex or concave
+            const double yMid = curve.interpolate(0.5f, l0, l1);
+            flattenCurve(polyline, curve, time0, timeRange, l0, l1, 0.0, level0, 0.5, yMid, tolerance, xScale, yScale, maxDepth - 1);
+            flattenCurve(polyline, curve, time0, timeRange, l0, l1, 0.5, yMid, 1.0, level1, tolerance, xScale, yScale, maxDepth - 1);
+            polyline.pop_back();
+        } break;
+            
+        default:
+        {
+            flattenCurve(polyline, curve, time0, timeRange, l0, l1, 0.0, level0, 1.0, level1, tolerance, xScale, yScale, maxDepth);
+            polyline.pop_back();
+        }
+    }
+    
+    polyline.push_back(Point<double>(time1, level1));
+}
+
+Buffer Env::toBuffer(const double sampleRate) const throw()
+{
+    assert(sampleRate > 0.0);
+    
+    Buffer buffer ((size_t) (duration() * sampleRate));
+    writeToBuffer(buffer);
+    return buffer;
+}
+
+void Env::writeToBuffer(Buffer& buffer) const throw()
+{
+    const int size = (int) buffer.size();
+    const double duration = this->duration();
+    
+    if(size == 0)
+        return;
+    
+    if(duration <= 0.0)
+    {
+        std::fill(buffer.begin(), buffer.end(), (double) lookup(0.f));
+        return;
+    }
+    
+    // render in chunks so this doesn't need a float copy of the whole buffer
+    const double sampleRate = size / duration;
+    float chunk[256];
+    
+    for(int i = 0; i < size; i += numElementsInArray(chunk))
+    {
+        const int count = jmin(size - i, (int) numElementsInArray(chunk));
+        render(chunk, count, sampleRate, i / sampleRate);
+        std::copy(chunk, chunk + count, buffer.begin() + i);
+    }
+}
+
+bool Env::operator== (Env const& other) const throw()
+{
+    return numLevels_ == other.numLevels_
+        && numTimes_ == other.numTimes_
+        && releaseNode_ == other.releaseNode_
+        && loopNode_ == other.loopNode_
+        && std::equal(levels_, levels_ + numLevels_, other.levels_)
+        && std::equal(times_, times_ + numTimes_, other.times_)
+        && std::equal(curves_, curves_ + numTimes_, other.curves_);
+}
+
+uint64 Env::hashCode() const throw()
+{
+    // FNV-1a over the values that operator== compares
+    uint64 hash = 14695981039346656037ULL;
+    
+    auto add = [&hash] (const uint64 value)
+    {
+        for(int i = 0; i < 8; i++)
+        {
+            hash ^= (value >> (i * 8)) & 0xff;
+            hash *= 1099511628211ULL;
+        }
+    };
+    
+    auto addDouble = [&add] (const double value)
+    {
+        const double positiveZero = value + 0.0; // -0.0 and 0.0 compare equal
+        uint64 bits;
+        std::memcpy(&bits, &positiveZero, sizeof(bits));
+        add(bits);
+    };
+    
+    add((uint64) numLevels_);
+    add((uint64) (int64) releaseNode_);
+    add((uint64) (int64) loopNode_);
+    
+    for(int i = 0; i < numLevels_; i++)
+        addDouble(levels_[i]);
+    
+    for(int i = 0; i < numTimes_; i++)
+    {
+        addDouble(times_[i]);
+        add((uint64) curves_[i].getType());
+        
+        // other types ignore the curve value when compared
+        if(curves_[i].getType() == EnvCurve::Numerical)
+            addDouble(curves_[i].getCurve());
+    }
+    
+    return hash;
+}
+
+EnvView::EnvView() throw()
+:   levels_(nullptr),
+    times_(nullptr),
+    curves_(nullptr),
+    numLevels_(0),
+    numTimes_(0),
+    releaseNode_(-1),
+    loopNode_(-1)
+{
+}
+
+EnvView::EnvView(Env const& env) throw()
+:   levels_(env.getLevels().data()),
+    times_(env.getTimes().data()),
+    curves_(env.getCurves().data()),
+    numLevels_(env.getLevels().size()),
+    numTimes_(env.getTimes().size()),
+    releaseNode_(env.getReleaseNode()),
+    loopNode_(env.getLoopNode())
+{
+}
+
+EnvView::EnvView(const double* levels, const double* times, const EnvCurve* curves,
+                 const int numSegments, const int releaseNode, const int loopNode) throw()
+:   levels_(levels),
+    times_(times),
+    curves_(curves),
+    numLevels_(numSegments + 1),
+    numTimes_(numSegments),
+    releaseNode_(releaseNode),
+    loopNode_(loopNode)
+{
+    assert(numSegments >= 0);
+    assert(levels != nullptr);
+}
+
+double EnvView::duration() const throw()
+{
+    double sum = 0.0;
+    
+    for (auto time : getTimes())
+        sum += time;
+    
+    return sum;
+}
+
+float EnvView::lookup(float time, EnvTransform const& transform, const EnvMath::Accuracy accuracy) const throw()
+{
+    time = (float) (time / transform.timeScale);
+
+    const int numTimes = numTimes_;
+    const int numLevels = numLevels_;
     const int lastLevel = numLevels-1;
 
     assert(numTimes == lastLevel);
 
     if(numLevels < 1) return 0.f;
-    if(time <= 0.f || numTimes == 0) return levels_[0];
+    if(time <= 0.f || numTimes == 0) return (float) transform.level(levels_[0]);
 
-    float lastTime = 0.f;
-    float stageTime = 0.f;
+    // accumulate in double so late segment boundaries don't jitter
+    double lastTime = 0.0;
+    double stageTime = 0.0;
     int stageIndex = 0;
 
     while(stageTime < time && stageIndex < numTimes)
@@ -133,90 +537,182 @@ float Env::lookup(float time) const throw()
         stageIndex++;
     }
 
-    if(stageIndex > numTimes) return levels_[lastLevel];
+    if(time > stageTime) return (float) transform.level(levels_[lastLevel]);
 
-    float level0 = levels_[stageIndex-1];
-    float level1 = levels_[stageIndex];
+    float level0 = (float) transform.level(levels_[stageIndex-1]);
+    float level1 = (float) transform.level(levels_[stageIndex]);
 
-    EnvCurve curve = curves_[stageIndex-1];
-    EnvCurve::CurveType type = curve.getType();
-    float curveValue = curve.getCurve();
-
-    if((lastTime - stageTime)==0.f)
+    if((lastTime - stageTime)==0.0)
     {
        return level1;
     }
-    else if(type == EnvCurve::Linear)
+    else
     {
-        return jmap(time, lastTime, stageTime, level0, level1);
+        float pos = (float) ((time-lastTime) / (stageTime-lastTime));
+        return getCurve(stageIndex-1).interpolate(pos, level0, level1, accuracy);
     }
-    else if(type == EnvCurve::Numerical)
+}
+
+void EnvView::lookupMany(const float* times, float* output, const int count) const throw()
+{
+    const int numTimes = numTimes_;
+    
+    if(numLevels_ < 1)
     {
-        if(abs(curveValue) <= 0.001)
+        FloatVectorOperations::fill(output, 0.f, count);
+        return;
+    }
+    
+    assert(numTimes == numLevels_-1);
+    
+    const float firstLevel = (float) levels_[0];
+    const float lastLevel = (float) levels_[numLevels_-1];
+    
+    // the cumulative times are only needed if the times go backwards
+    std::vector<double> endTimes;
+    
+    CompiledEnv::Segment segment;
+    int preparedIndex = -1;
+    int stageIndex = 0;
+    double stageStart = 0.0;
+    double stageEnd = numTimes > 0 ? times_[0] : 0.0;
+    float previousTime = 0.f;
+    
+    for(int i = 0; i < count; i++)
+    {
+        const float time = times[i];
+        
+        if(time <= 0.f || numTimes == 0)
+        {
+            output[i] = firstLevel;
+            continue;
+        }
+        
+        if(time < previousTime)
         {
-            return jmap(time, lastTime, stageTime, level0, level1);
+            if(endTimes.empty())
+            {
+                endTimes.resize(numTimes);
+                double sum = 0.0;
+                
+                for(int j = 0; j < numTimes; j++)
+                    endTimes[j] = sum += times_[j];
+            }
+            
+            stageIndex = (int) (std::lower_bound(endTimes.begin(), endTimes.end(), (double) time) - endTimes.begin());
+            stageStart = stageIndex > 0 ? endTimes[stageIndex-1] : 0.0;
+            stageEnd = stageIndex < numTimes ? endTimes[stageIndex] : stageStart;
         }
         else
         {
-            float pos = (time-lastTime) / (stageTime-lastTime);
-            float denom = 1.f - std::exp(curveValue);
-            float numer = 1.f - std::exp(pos * curveValue);
-            return level0 + (level1 - level0) * (numer/denom);
+            // the sums are the same as endTimes so the two searches agree
+            while(stageIndex < numTimes && stageEnd < time)
+            {
+                stageStart = stageEnd;
+                
+                if(++stageIndex < numTimes)
+                    stageEnd += times_[stageIndex];
+            }
         }
+        
+        previousTime = time;
+        
+        if(stageIndex >= numTimes)
+        {
+            output[i] = lastLevel;
+            continue;
+        }
+        
+        if(stageIndex != preparedIndex)
+        {
+            segment.prepare(stageStart, stageEnd,
+                            (float) levels_[stageIndex], (float) levels_[stageIndex+1],
+                            curves_[stageIndex], EnvMath::Exact);
+            preparedIndex = stageIndex;
+        }
+        
+        output[i] = segment.evaluate((time - stageStart) * segment.reciprocalDuration);
     }
-    else if(type == EnvCurve::Sine)
+}
+
+void EnvView::render(float* output, const int numSamples, const double sampleRate, const double startTime,
+                     EnvTransform const& transform) const throw()
+{
+    assert(sampleRate > 0.0);
+    
+    const int numTimes = numTimes_;
+    const int numLevels = numLevels_;
+    
+    if(numLevels < 1)
     {
-        return jmap(time, lastTime, stageTime, level0, level1);
+        FloatVectorOperations::fill(output, 0.f, numSamples);
+        return;
     }
-    else if(type == EnvCurve::Exponential)
+    
+    assert(numTimes == numLevels-1);
+    
+    const double timeIncrement = 1.0 / sampleRate;
+    int i = 0;
+    
+    // the samples at or before time zero
+    if(startTime <= 0.0)
     {
-        return jmap(time, lastTime, stageTime, level0, level1);
+        i = jlimit(0, numSamples, (int) std::floor(-startTime * sampleRate) + 1);
+        FloatVectorOperations::fill(output, (float) transform.level(levels_[0]), i);
     }
-    else if(type == EnvCurve::Welch)
+    
+    double stageStart = 0.0;
+    
+    for(int stageIndex = 0; stageIndex < numTimes && i < numSamples; stageIndex++)
     {
-        return jmap(time, lastTime, stageTime, level0, level1);
+        const double stageEnd = stageStart + transform.time(times_[stageIndex]);
+        const int64 last = (int64) std::floor((stageEnd - startTime) * sampleRate);
+        const int count = (int) jmin((int64) (numSamples - i), last - i + 1);
+        
+        if(count > 0 && stageEnd > stageStart)
+        {
+            const double reciprocalDuration = 1.0 / (stageEnd - stageStart);
+            const EnvCurve curve = getCurve(stageIndex);
+            
+            EnvGenSegment::render(output + i, count,
+                                  transform.level(levels_[stageIndex]), transform.level(levels_[stageIndex+1]),
+                                  curve.getType(), curve.getCurve(),
+                                  (startTime + i * timeIncrement - stageStart) * reciprocalDuration,
+                                  timeIncrement * reciprocalDuration);
+            i += count;
+        }
+        
+        stageStart = stageEnd;
     }
-    else
+    
+    if(i < numSamples)
+        FloatVectorOperations::fill(output + i, (float) transform.level(levels_[jmin(numTimes, numLevels-1)]), numSamples - i);
+}
+
+EnvPolyline EnvView::toPolyline(const double tolerance, const double xScale, const double yScale) const throw()
+{
+    EnvPolyline polyline;
+    
+    if(numLevels_ < 1)
+        return polyline;
+    
+    polyline.reserve(numLevels_);
+    polyline.push_back(Point<double>(0.0, levels_[0]));
+    
+    double time = 0.0;
+    
+    for(int i = 0; i < numTimes_; i++)
     {
-        // Empty or Step
-        return level1;
+        const double nextTime = time + times_[i];
+        
+        Env::appendSegmentToPolyline(polyline, time, levels_[i], nextTime, levels_[i+1], curves_[i],
+                                     tolerance, xScale, yScale);
+        time = nextTime;
     }
+    
+    return polyline;
 }
 
-//Env::operator Buffer () const throw()
-//{
-//    const float duration = getTimes().sum();
-//    const int size = UGen::getSampleRate() * duration;
-//    Buffer buffer = BufferSpec(size, 1, false);
-//    float *bufferSamples = buffer.getData();
-//
-//    double time = 0.0;
-//    for(int i = 0; i < size; i++, time += UGen::getReciprocalSampleRate())
-//    {
-//        *bufferSamples++ = lookup(time);
-//    }
-//
-//    return buffer;
-//}
-
-//void Env::writeToBuffer(Buffer& buffer, const int channel) const throw()
-//{
-//    const double duration = getTimes().sum();
-//    const int size = buffer.size();
-//
-//    assert(size > 0);
-//    assert(buffer.getNumChannels() > 0);
-//
-//    float *bufferSamples = buffer.getData(channel % buffer.getNumChannels());
-//
-//    const double timeInc = duration / size;
-//    double time = 0.0;
-//    for(int i = 0; i < size; i++, time += timeInc)
-//    {
-//        *bufferSamples++ = lookup(time);
-//    }
-//}
-
 Env Env::linen(const double attackTime, 
 			   const double sustainTime, 
 			   const double releaseTime, 
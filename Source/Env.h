@@ -47,6 +47,138 @@ using Buffer = std::vector<double>;
 
 #include "EnvCurve.h"
 using EnvCurveList = std::vector<EnvCurve>;
+using EnvPolyline = std::vector<Point<double>>;
+
+#include <initializer_list>
+#include <memory>
+
+/** A lightweight view of one of the arrays stored inside an Env.
+ This does not own its elements, it is only valid while the Env it came from
+ is alive and has not been reassigned. */
+template <typename ElementType>
+class EnvArray
+{
+public:
+    EnvArray(ElementType* data, const int size) throw() : data_(data), size_(size) { }
+    
+    inline int size() const throw()                     { return size_;         }
+    inline bool empty() const throw()                   { return size_ == 0;    }
+    inline ElementType* data() const throw()            { return data_;         }
+    inline ElementType* begin() const throw()           { return data_;         }
+    inline ElementType* end() const throw()             { return data_ + size_; }
+    
+    inline ElementType& operator[](const int index) const throw()
+    {
+        assert(index >= 0 && index < size_);
+        return data_[index];
+    }
+    
+private:
+    ElementType* data_;
+    int size_;
+};
+
+/** A scale and offset for the levels of an Env and a scale for its times.
+ 
+ This can be passed to lookup() and render() in Env and CompiledEnv, or to an
+ EnvGen, to play an envelope scaled (e.g., by velocity or key tracking) without
+ copying it. Levels become level * levelScale + levelBias and times become
+ time * timeScale, the same as Env::levelScale() then levelBias() then timeScale().
+ 
+ @ingroup EnvUGens
+ @see Env */
+struct EnvTransform
+{
+    EnvTransform() throw()
+    :   levelScale(1.0), levelBias(0.0), timeScale(1.0)
+    {
+    }
+    
+    EnvTransform(const double newLevelScale, const double newLevelBias, const double newTimeScale) throw()
+    :   levelScale(newLevelScale), levelBias(newLevelBias), timeScale(newTimeScale)
+    {
+        assert(timeScale > 0.0);
+    }
+    
+    inline double level(const double level) const throw()   { return level * levelScale + levelBias; }
+    inline double time(const double time) const throw()     { return time * timeScale; }
+    
+    double levelScale;
+    double levelBias;
+    double timeScale;
+};
+
+class Env;
+
+/** A read-only view of the levels, times and curves of an envelope stored elsewhere.
+ 
+ This is what Env stores internally without the ownership, so it can look at an
+ Env or at envelopes packed in memory by something else (e.g., a memory-mapped
+ EnvBank) without copying them. It is only valid while that memory is. There must
+ be one curve per segment, they are not reused cyclically as the Env constructors do.
+ 
+ @ingroup EnvUGens
+ @see Env EnvBank */
+class EnvView
+{
+public:
+    /** Creates an empty view which always returns 0. */
+    EnvView() throw();
+    
+    /** Creates a view of an Env. */
+    EnvView(Env const& env) throw();
+    
+    /** Creates a view of arrays of levels, times and curves.
+     @param levels          The levels, there is one more level than segments.
+     @param times           The durations of the segments.
+     @param curves          The curves, one for each segment.
+     @param numSegments     The number of segments.
+     @param releaseNode     The release node or -1.
+     @param loopNode        The loop node or -1. */
+    EnvView(const double* levels, const double* times, const EnvCurve* curves,
+            const int numSegments, const int releaseNode = -1, const int loopNode = -1) throw();
+    
+    inline EnvArray<const double>       getTimes()  const throw()   { return { times_, numTimes_ };   }
+    inline EnvArray<const double>       getLevels() const throw()   { return { levels_, numLevels_ }; }
+    inline EnvArray<const EnvCurve>     getCurves() const throw()   { return { curves_, numTimes_ };  }
+    
+    inline int getNumSegments() const throw()                       { return numTimes_;     }
+    inline int getReleaseNode() const throw()                       { return releaseNode_;  }
+    inline int getLoopNode() const throw()                          { return loopNode_;     }
+    
+    inline EnvCurve const& getCurve(const int segment) const throw()
+    {
+        assert(segment >= 0 && segment < numTimes_);
+        return curves_[segment];
+    }
+    
+    /** Returns the sum the time values in the envelope. */
+    double duration() const throw();
+    
+    /** The same as Env::lookup(). */
+    float lookup(float time,
+                 EnvTransform const& transform = EnvTransform(),
+                 const EnvMath::Accuracy accuracy = EnvMath::Exact) const throw();
+    
+    /** The same as Env::lookupMany(). */
+    void lookupMany(const float* times, float* output, const int count) const throw();
+    
+    /** The same as Env::render(). */
+    void render(float* output, const int numSamples, const double sampleRate, const double startTime = 0.0,
+                EnvTransform const& transform = EnvTransform()) const throw();
+    
+    /** The same as Env::toPolyline(). */
+    EnvPolyline toPolyline(const double tolerance, const double xScale = 1.0, const double yScale = 1.0) const throw();
+    
+private:
+    const double* levels_;
+    const double* times_;
+    const EnvCurve* curves_;
+    int numLevels_;
+    int numTimes_;
+    int releaseNode_;
+    int loopNode_;
+};
 
 /** A specification for a segmented envelope.
  
@@ -65,12 +197,42 @@ using EnvCurveList = std::vector<EnvCurve>;
 class Env
 {
 public:
-    Env(Buffer const& levels = { 0.0, 1.0, 0.0 },
-        Buffer const& times =  { 1.0, 1.0 }, /* There should be one fewer time than level. */
+    /** Creates an envelope from lists of levels, times and curves.
+     Envelopes with up to numInlineSegments segments are stored inside the Env
+     object itself so creating or copying them does not allocate any memory,
+     longer envelopes use a single heap block. If there are fewer curves than
+     times the curves are reused cyclically (as in SuperCollider). */
+    Env(std::initializer_list<double> levels = { 0.0, 1.0, 0.0 },
+        std::initializer_list<double> times =  { 1.0, 1.0 }, /* There should be one fewer time than level. */
+        std::initializer_list<EnvCurve> curves = { EnvCurve::Linear },
+        const int releaseNode = -1,
+        const int loopNode = -1) throw();
+    
+    /** Creates an envelope from buffers of levels, times and curves. */
+    Env(Buffer const& levels,
+        Buffer const& times, /* There should be one fewer time than level. */
         EnvCurveList const& curves = { EnvCurve::Linear },
 		const int releaseNode = -1,
 		const int loopNode = -1
 	) throw();
+    
+    /** Creates an envelope with a number of segments for filling in place.
+     The levels and times are all zero and the curves are all linear, use
+     getLevels(), getTimes() and getCurves() to set them. */
+    explicit Env(const int numSegments,
+                 const int releaseNode = -1,
+                 const int loopNode = -1) throw();
+    
+    /** Creates an envelope by copying the one an EnvView looks at. */
+    explicit Env(EnvView const& view) throw();
+    
+    Env(Env const& other) throw();
+    Env(Env&& other) throw();
+    Env& operator= (Env const& other) throw();
+    Env& operator= (Env&& other) throw();
+    
+    /** The number of segments that can be stored without allocating. */
+    enum { numInlineSegments = 8 };
 				
 	/** Creates a new envelope specification which has a trapezoidal shape.
 	 @param attackTime		The duration of the attack portion.
@@ -146,13 +308,19 @@ public:
 	/// @name Envelope access and manipulation
 	/// @{
 	
-    inline Buffer&			getTimes()   throw()	{ return times_;  }
-	inline Buffer&			getLevels()  throw()	{ return levels_; }
-	inline EnvCurveList&	getCurves()  throw()	{ return curves_; }
+    inline EnvArray<double>             getTimes()   throw()          { return { times_, numTimes_ };   }
+    inline EnvArray<double>             getLevels()  throw()          { return { levels_, numLevels_ }; }
+    inline EnvArray<EnvCurve>           getCurves()  throw()          { return { curves_, numTimes_ };  }
 
-    inline const Buffer&            getTimes()   const throw()    { return times_;  }
-    inline const Buffer&            getLevels()  const throw()    { return levels_; }
-    inline const EnvCurveList&      getCurves()  const throw()    { return curves_; }
+    inline EnvArray<const double>       getTimes()   const throw()    { return { times_, numTimes_ };   }
+    inline EnvArray<const double>       getLevels()  const throw()    { return { levels_, numLevels_ }; }
+    inline EnvArray<const EnvCurve>     getCurves()  const throw()    { return { curves_, numTimes_ };  }
+
+	/** Returns the curve for a segment.
+	 There is always one curve per time, the curves passed to the constructor are
+	 reused cyclically (as in SuperCollider) so, for example, a single curve applies
+	 to every segment. */
+	EnvCurve const& getCurve(const int segment) const throw();
 
 	inline int getReleaseNode() const throw()	{ return releaseNode_;	}
 	inline int getLoopNode() const throw()		{ return loopNode_;		}
@@ -160,36 +328,134 @@ public:
 	/** Returns the sum the time values in the envelope. */
 	double duration() const throw();
 	
+	/** Scales the levels of this envelope by a constant. */
+	Env& scaleLevels(const double scale) throw();
+	
+	/** Offsets the levels of this envelope by a constant. */
+	Env& biasLevels(const double bias) throw();
+	
+	/** Scales the time values of this envelope by a constant. */
+	Env& scaleTimes(const double scale) throw();
+	
 	/** Returns a new envelope with the levels scaled by a constant. */
-	Env levelScale(const double scale) const throw();
+	Env levelScale(const double scale) const& throw();
+	Env levelScale(const double scale) && throw();
 	
 	/** Returns a new envelope with the levels offset by a constant. */
-	Env levelBias(const double bias) const throw();
+	Env levelBias(const double bias) const& throw();
+	Env levelBias(const double bias) && throw();
 	
 	/** Returns a new envelope with the time values scaled by a constant. */
-	Env timeScale(const double scale) const throw();
+	Env timeScale(const double scale) const& throw();
+	Env timeScale(const double scale) && throw();
 		
     /** Get the level of the Env a ta given time.
+     This ignores loopNode and releaseNode if the are set. Times before the start
+     return the first level and times after the end return the last level, as
+     CompiledEnv and StaticEnv do (earlier versions extrapolated the last segment).
+     @param time        The time to look up.
+     @param transform   A scaling applied to the levels and times as they are used.
+     @param accuracy    Whether Numerical curves use std::exp() or EnvMath::fastExp(). */
+    float lookup(float time,
+                 EnvTransform const& transform = EnvTransform(),
+                 const EnvMath::Accuracy accuracy = EnvMath::Exact) const throw();
+    
+    /** Get the levels of the Env at many times.
+     Sorted times are found in a single pass over the segments, O(n + m) rather than
+     the O(n * m) of calling lookup() for each time. A time earlier than the previous
+     one is found with a binary search so unsorted times still work.
+     This ignores loopNode and releaseNode if the are set.
+     @param times   The times to look up.
+     @param output  The buffer to write the levels to, this may be the same as times.
+     @param count   The number of times. */
+    void lookupMany(const float* times, float* output, const int count) const throw();
+
+    /** Write the Env into a buffer at a given sample rate.
+     The buffer is only split at segment boundaries and each segment is written with
+     vectorised incremental recurrences so this is much faster than calling lookup()
+     for each sample. This does not allocate any memory.
+     This ignores loopNode and releaseNode if the are set.
+     @param output      The buffer to write to.
+     @param numSamples  The number of samples to write.
+     @param sampleRate  The sample rate used to convert from samples to time.
+     @param startTime   The time of the first sample.
+     @param transform   A scaling applied to the levels and times as they are used. */
+    void render(float* output, const int numSamples, const double sampleRate, const double startTime = 0.0,
+                EnvTransform const& transform = EnvTransform()) const throw();
+    
+    /** Approximates the Env with straight lines, e.g., for drawing.
+     Linear segments give a single point and curved segments are subdivided until
+     the lines are within tolerance of the curve everywhere. The error is measured
+     after multiplying times by xScale and levels by yScale, so with scales in pixels
+     per unit the tolerance is in pixels.
+     This ignores loopNode and releaseNode if the are set.
+     @return    The points as x = time and y = level, starting at time zero. */
+    EnvPolyline toPolyline(const double tolerance, const double xScale = 1.0, const double yScale = 1.0) const throw();
+    
+    /** Appends the points approximating one segment to a polyline.
+     The start of the segment is not added so consecutive segments can be appended
+     without repeating points, the end always is.
+     @param polyline    The polyline to add to.
+     @param time0       The time at the start of the segment.
+     @param level0      The level at the start of the segment.
+     @param time1       The time at the end of the segment.
+     @param level1      The level at the end of the segment.
+     @param curve       The curve of the segment.
+     @param tolerance   The largest distance allowed between the lines and the curve.
+     @param xScale      The scale applied to times when measuring the distance.
+     @param yScale      The scale applied to levels when measuring the distance. */
+    static void appendSegmentToPolyline(EnvPolyline& polyline,
+                                        const double time0, const double level0,
+                                        const double time1, const double level1,
+                                        EnvCurve const& curve,
+                                        const double tolerance, const double xScale, const double yScale) throw();
+    
+    /** Turn the Env into a table in a Buffer.
+     The new Buffer has a duration which is the sum of this Env's times at the given
+     sample rate. This ignores loopNode and releaseNode if the are set. */
+    Buffer toBuffer(const double sampleRate) const throw();
+    
+    /** Write the Env into an exisiting Buffer.
+     This fits the Env into whatever size the Buffer is, the first sample is at time
+     zero and the samples are duration() / size apart.
      This ignores loopNode and releaseNode if the are set. */
-    float lookup(float time) const throw();
-//
-//    /** Turn the Env into a table in a Buffer.
-//     The new Buffer has a duration which is the sum of this Env's times.
-//     This ignores loopNode and releaseNode if the are set. */
-//    operator Buffer () const throw();
-//
-//    /** Write the Env into an exisiting Buffer.
-//     This fits the Env into whatever size the Buffer is.
-//     This ignores loopNode and releaseNode if the are set. */
-//    void writeToBuffer(Buffer& buffer, const int channel = 0) const throw();
+    void writeToBuffer(Buffer& buffer) const throw();
+    
+    /** Returns true if the levels, times, curves and nodes are all the same. */
+    bool operator== (Env const& other) const throw();
+    bool operator!= (Env const& other) const throw()   { return ! operator== (other); }
+    
+    /** Returns a hash of the levels, times, curves and nodes.
+     Envelopes which compare equal have the same hash. */
+    uint64 hashCode() const throw();
 	
 	/// @} <!-- end Envelope access and manipulation ----------------------------- -->
 	
 private:
-    Buffer levels_;
-    Buffer times_;
-    EnvCurveList curves_;
+    static size_t getStorageSize(const int numLevels, const int numTimes) throw();
+    void allocate(const int numLevels, const int numTimes) throw();
+    void initialise(const double* levels, const int numLevels,
+                    const double* times, const int numTimes,
+                    const EnvCurve* curves, const int numCurves) throw();
+    void copyFrom(Env const& other) throw();
+    void moveFrom(Env& other) throw();
+    
+    enum
+    {
+        inlineStorageSize = (numInlineSegments * 2 + 1) * sizeof(double) + numInlineSegments * sizeof(EnvCurve)
+    };
+    
+    // the levels, times and curves are stored contiguously in that order either
+    // in inlineStorage_ or, if they don't fit, in heapStorage_
+    double* levels_;
+    double* times_;
+    EnvCurve* curves_;
+    int numLevels_;
+    int numTimes_;
     int releaseNode_;
     int loopNode_;
+    std::unique_ptr<char[]> heapStorage_;
+    size_t heapStorageSize_;
+    alignas(double) char inlineStorage_[inlineStorageSize];
 };
 
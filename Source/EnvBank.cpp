@@ -0,0 +1,221 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#include "EnvBank.h"
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// the curves are read straight from the bank data so their layout is part of the format
+static_assert(sizeof(double) == 8, "The bank format stores 64-bit doubles");
+static_assert(sizeof(EnvCurve) == 8, "The bank format stores each EnvCurve as a 32-bit type and a float");
+static_assert(sizeof(EnvCurve::CurveType) == 4, "The bank format stores the curve type in 32 bits");
+static_assert(std::is_trivially_copyable<EnvCurve>::value, "EnvCurve must be trivially copyable to be read in place");
+static_assert(std::is_standard_layout<EnvCurve>::value, "EnvCurve must be standard layout to be read in place");
+
+struct EnvBank::Header
+{
+    char magic[4];
+    uint32 version;
+    uint32 byteOrder;
+    uint32 numEnvs;
+    uint64 indexOffset;
+    uint64 totalSize;
+};
+
+struct EnvBank::IndexEntry
+{
+    uint64 offset;
+    int32 numSegments;
+    int32 releaseNode;
+    int32 loopNode;
+    int32 reserved;
+};
+
+static const char bankMagic[4] = { 'E', 'N', 'V', 'B' };
+static const uint32 bankByteOrder = 0x01020304;
+
+static inline uint64 alignBankOffset(const uint64 offset) throw()
+{
+    return (offset + 7) & ~(uint64) 7;
+}
+
+static inline uint64 getBankRecordSize(const int numSegments) throw()
+{
+    // widen first, the count comes from the file and may be anything up to INT_MAX
+    return alignBankOffset(((uint64) numSegments * 2 + 1) * sizeof(double) + (uint64) numSegments * sizeof(EnvCurve));
+}
+
+EnvBank::EnvBank() throw()
+:   data_(nullptr),
+    index_(nullptr),
+    numEnvs_(0)
+{
+}
+
+EnvBank::EnvBank(const void* data, const size_t size) throw()
+:   EnvBank()
+{
+    open(data, size);
+}
+
+EnvBank::EnvBank(File const& file) throw()
+:   EnvBank()
+{
+    file_.reset(new MemoryMappedFile(file, MemoryMappedFile::readOnly));
+    open(file_->getData(), file_->getSize());
+}
+
+void EnvBank::open(const void* data, const size_t size) throw()
+{
+    static_assert(sizeof(Header) == 32, "The bank header must be 32 bytes");
+    static_assert(sizeof(IndexEntry) == 24, "Each bank index entry must be 24 bytes");
+    
+    if (data == nullptr || size < sizeof(Header) || (reinterpret_cast<uintptr_t>(data) & 7) != 0)
+        return;
+    
+    const char* const bytes = static_cast<const char*>(data);
+    const Header& header = *reinterpret_cast<const Header*>(bytes);
+    
+    if (std::memcmp(header.magic, bankMagic, sizeof(bankMagic)) != 0
+        || header.version != currentVersion
+        || header.byteOrder != bankByteOrder
+        || header.totalSize > size
+        || header.numEnvs > (uint32) std::numeric_limits<int>::max()
+        || header.indexOffset != alignBankOffset(header.indexOffset)
+        || header.indexOffset > header.totalSize
+        || (header.totalSize - header.indexOffset) / sizeof(IndexEntry) < header.numEnvs)
+        return;
+    
+    const IndexEntry* const index = reinterpret_cast<const IndexEntry*>(bytes + header.indexOffset);
+    
+    // check the index once here so getEnv() doesn't need to
+    for (uint32 i = 0; i < header.numEnvs; ++i)
+    {
+        const IndexEntry& entry = index[i];
+        
+        if (entry.numSegments < 0
+            || (uint64) entry.numSegments > header.totalSize / (2 * sizeof(double) + sizeof(EnvCurve))
+            || entry.offset != alignBankOffset(entry.offset)
+            || entry.offset > header.totalSize
+            || header.totalSize - entry.offset < getBankRecordSize(entry.numSegments))
+            return;
+    }
+    
+    data_ = bytes;
+    index_ = index;
+    numEnvs_ = (int) header.numEnvs;
+}
+
+EnvView EnvBank::getEnv(const int index) const throw()
+{
+    assert(index >= 0 && index < numEnvs_);
+    
+    const IndexEntry& entry = index_[index];
+    const double* const levels = reinterpret_cast<const double*>(data_ + entry.offset);
+    const double* const times = levels + entry.numSegments + 1;
+    const EnvCurve* const curves = reinterpret_cast<const EnvCurve*>(times + entry.numSegments);
+    
+    return EnvView(levels, times, curves, entry.numSegments, entry.releaseNode, entry.loopNode);
+}
+
+void EnvBank::write(const Env* envs, const int numEnvs, MemoryBlock& data) throw()
+{
+    assert(numEnvs >= 0);
+    
+    const uint64 indexOffset = sizeof(Header);
+    uint64 totalSize = alignBankOffset(indexOffset + (uint64) numEnvs * sizeof(IndexEntry));
+    
+    for (int i = 0; i < numEnvs; ++i)
+        totalSize += getBankRecordSize(envs[i].getTimes().size());
+    
+    data.setSize((size_t) totalSize, true);
+    
+    char* const bytes = static_cast<char*>(data.getData());
+    Header& header = *reinterpret_cast<Header*>(bytes);
+    
+    std::memcpy(header.magic, bankMagic, sizeof(bankMagic));
+    header.version = currentVersion;
+    header.byteOrder = bankByteOrder;
+    header.numEnvs = (uint32) numEnvs;
+    header.indexOffset = indexOffset;
+    header.totalSize = totalSize;
+    
+    IndexEntry* const index = reinterpret_cast<IndexEntry*>(bytes + indexOffset);
+    uint64 offset = alignBankOffset(indexOffset + (uint64) numEnvs * sizeof(IndexEntry));
+    
+    for (int i = 0; i < numEnvs; ++i)
+    {
+        const auto levels = envs[i].getLevels();
+        const auto times = envs[i].getTimes();
+        const auto curves = envs[i].getCurves();
+        
+        const int numSegments = times.size();
+        
+        IndexEntry& entry = index[i];
+        entry.offset = offset;
+        entry.numSegments = numSegments;
+        entry.releaseNode = envs[i].getReleaseNode();
+        entry.loopNode = envs[i].getLoopNode();
+        entry.reserved = 0;
+        
+        char* const record = bytes + offset;
+        
+        // every record has at least one level, an empty Env is stored as a single zero level
+        const double zeroLevel = 0.0;
+        
+        if (levels.empty())
+            std::memcpy(record, &zeroLevel, sizeof(double));
+        else
+            std::memcpy(record, levels.data(), (numSegments + 1) * sizeof(double));
+
+        std::memcpy(record + (numSegments + 1) * sizeof(double), times.data(), numSegments * sizeof(double));
+        std::memcpy(record + (numSegments * 2 + 1) * sizeof(double), curves.data(), numSegments * sizeof(EnvCurve));
+        
+        offset += getBankRecordSize(numSegments);
+    }
+    
+    assert(offset == totalSize);
+}
+
+bool EnvBank::writeToFile(const Env* envs, const int numEnvs, File const& file) throw()
+{
+    MemoryBlock data;
+    write(envs, numEnvs, data);
+    return file.replaceWithData(data.getData(), data.getSize());
+}
@@ -0,0 +1,113 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#pragma once
+
+#include "Env.h"
+
+/** A bank of envelopes in a binary format that can be used without parsing.
+ 
+ The format is designed to be memory-mapped: the envelopes are read in place
+ through EnvView objects, so opening a bank of any size only checks its index
+ and nothing is copied or allocated per envelope. An EnvView from a bank can be
+ passed to CompiledEnv, or looked up and rendered directly.
+ 
+ All values are in the byte order of the machine that wrote the bank (a bank
+ written on a machine with the other byte order is rejected) and every block
+ is 8-byte aligned:
+ 
+ - Header (32 bytes): the characters "ENVB", a uint32 version, a uint32 byte order
+   marker, a uint32 number of envelopes, a uint64 offset to the index and the
+   uint64 total size of the bank.
+ - Index (24 bytes per envelope): a uint64 offset to the envelope's data, then
+   int32 number of segments, release node, loop node and a reserved zero.
+ - Data for each envelope: the levels (one more than segments) and the times as
+   doubles, then one EnvCurve (a 32-bit curve type and a float) per segment,
+   padded to a multiple of 8 bytes.
+ 
+ @ingroup EnvUGens
+ @see EnvView Env CompiledEnv */
+class EnvBank
+{
+public:
+    enum { currentVersion = 1 };
+    
+    /** Creates an empty bank. */
+    EnvBank() throw();
+    
+    /** Opens a bank which is already in memory.
+     The data is not copied so it must stay valid, and unchanged, for as long as
+     this bank and any EnvView taken from it are used. It must be 8-byte aligned.
+     Use isValid() to check that it was opened. */
+    EnvBank(const void* data, const size_t size) throw();
+    
+    /** Opens a bank file by memory-mapping it.
+     Use isValid() to check that it was opened. */
+    explicit EnvBank(File const& file) throw();
+    
+    /** Returns true if the data was a valid bank of this version. */
+    inline bool isValid() const throw()         { return data_ != nullptr; }
+    
+    inline int getNumEnvs() const throw()       { return numEnvs_; }
+    
+    /** Returns a view of one of the envelopes in the bank.
+     This is only valid for as long as the bank is. */
+    EnvView getEnv(const int index) const throw();
+    
+    /** Writes envelopes in the bank format.
+     @param envs        The envelopes.
+     @param numEnvs     The number of envelopes.
+     @param data        The block to write to, this is resized to fit. */
+    static void write(const Env* envs, const int numEnvs, MemoryBlock& data) throw();
+    
+    /** Writes envelopes to a bank file, replacing the file if it exists.
+     @return    true if the file was written. */
+    static bool writeToFile(const Env* envs, const int numEnvs, File const& file) throw();
+    
+private:
+    struct Header;
+    struct IndexEntry;
+    
+    void open(const void* data, const size_t size) throw();
+    
+    std::unique_ptr<MemoryMappedFile> file_;
+    const char* data_;
+    const IndexEntry* index_;
+    int numEnvs_;
+    
+    JUCE_DECLARE_NON_COPYABLE(EnvBank)
+};
@@ -0,0 +1,135 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#include "EnvBatchRenderer.h"
+
+class EnvBatchRenderer::Worker : public ThreadPoolJob
+{
+public:
+    Worker(EnvBatchRenderer& owner) throw()
+    :   ThreadPoolJob("EnvBatchRenderer"),
+        owner_(owner)
+    {
+    }
+    
+    JobStatus runJob() override
+    {
+        owner_.renderClaimedJobs();
+        return jobHasFinished;
+    }
+    
+private:
+    EnvBatchRenderer& owner_;
+};
+
+static int getNumRenderThreads(const int numThreads) throw()
+{
+    return jmax(1, numThreads > 0 ? numThreads : SystemStats::getNumCpus());
+}
+
+EnvBatchRenderer::EnvBatchRenderer(const int numThreads) throw()
+:   pool_(jmax(1, getNumRenderThreads(numThreads) - 1)),
+    jobs_(nullptr),
+    numJobs_(0),
+    grainSize_(1),
+    nextJob_(0)
+{
+    const int numWorkers = getNumRenderThreads(numThreads) - 1;
+    
+    for (int i = 0; i < numWorkers; ++i)
+        workers_.add(new Worker(*this));
+}
+
+EnvBatchRenderer::~EnvBatchRenderer()
+{
+    pool_.removeAllJobs(true, -1);
+}
+
+void EnvBatchRenderer::render(const Job* jobs, const int numJobs, const int grainSize) throw()
+{
+    if (numJobs <= 0)
+        return;
+    
+    jobs_ = jobs;
+    numJobs_ = numJobs;
+    grainSize_ = jmax(1, grainSize);
+    nextJob_.store(0, std::memory_order_relaxed);
+    
+    // don't wake more threads than there are grains to share out
+    const int numGrains = (numJobs + grainSize_ - 1) / grainSize_;
+    const int numWorkers = jmin(workers_.size(), numGrains - 1);
+    
+    for (int i = 0; i < numWorkers; ++i)
+        pool_.addJob(workers_[i], false);
+    
+    renderClaimedJobs();
+    
+    for (int i = 0; i < numWorkers; ++i)
+        pool_.waitForJobToFinish(workers_[i], -1);
+    
+    jobs_ = nullptr;
+    numJobs_ = 0;
+}
+
+void EnvBatchRenderer::renderClaimedJobs() throw()
+{
+    const Job* const jobs = jobs_;
+    const int numJobs = numJobs_;
+    const int grainSize = grainSize_;
+    
+    for (;;)
+    {
+        const int first = nextJob_.fetch_add(grainSize, std::memory_order_relaxed);
+        
+        if (first >= numJobs)
+            return;
+        
+        const int last = jmin(numJobs, first + grainSize);
+        
+        for (int i = first; i < last; ++i)
+            renderJob(jobs[i]);
+    }
+}
+
+void EnvBatchRenderer::renderJob(Job const& job) throw()
+{
+    assert(job.env != nullptr);
+    assert(job.sampleRate > 0.0);
+    
+    if (job.numSamples > 0)
+        job.env->render(job.output, job.numSamples, job.sampleRate);
+}
@@ -0,0 +1,105 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#pragma once
+
+#include "Env.h"
+
+#include <atomic>
+
+/** Renders many envelopes to audio rate buffers on a pool of threads.
+ 
+ This is for offline work such as auditioning or checking whole banks of presets.
+ Each job renders one envelope with Env::render() into a buffer that the caller
+ has already allocated. The jobs are claimed a few at a time from a shared atomic
+ counter so a thread that finishes early simply takes more, long and short
+ envelopes balance out without any locking. The calling thread takes jobs too.
+ 
+ @ingroup EnvUGens
+ @see Env */
+class EnvBatchRenderer
+{
+public:
+    /** One envelope to render. */
+    struct Job
+    {
+        const Env* env;         ///< The envelope, this must stay valid until render() returns.
+        double sampleRate;
+        int numSamples;
+        float* output;          ///< Where to write, this must hold at least numSamples samples.
+    };
+    
+    /** Creates a renderer.
+     @param numThreads  The total number of threads to render on including the
+                        calling thread, 0 uses one for each CPU. */
+    EnvBatchRenderer(const int numThreads = 0) throw();
+    ~EnvBatchRenderer();
+    
+    /** Renders all the jobs and returns when they are finished.
+     This must not be called from more than one thread at once.
+     @param jobs        The jobs, in any order.
+     @param numJobs     The number of jobs.
+     @param grainSize   The number of jobs each thread claims at a time, larger
+                        values reduce contention when the envelopes are short. */
+    void render(const Job* jobs, const int numJobs, const int grainSize = 8) throw();
+    
+    /** Renders the jobs that are in an array. */
+    inline void render(Array<Job> const& jobs, const int grainSize = 8) throw()
+    {
+        render(jobs.getRawDataPointer(), jobs.size(), grainSize);
+    }
+    
+    /** Renders a single job on the calling thread. */
+    static void renderJob(Job const& job) throw();
+    
+    /** Returns the total number of threads including the calling thread. */
+    inline int getNumThreads() const throw() { return workers_.size() + 1; }
+    
+private:
+    class Worker;
+    
+    void renderClaimedJobs() throw();
+    
+    ThreadPool pool_;
+    OwnedArray<Worker> workers_;
+    const Job* jobs_;
+    int numJobs_;
+    int grainSize_;
+    std::atomic<int> nextJob_;
+    
+    JUCE_DECLARE_NON_COPYABLE(EnvBatchRenderer)
+};
@@ -40,4 +40,53 @@
 
 #include "EnvCurve.h"
 
+#include "JuceHeader.h"
 
+float EnvCurve::interpolate(const float pos, const float level0, const float level1,
+                            const EnvMath::Accuracy accuracy) const throw()
+{
+    switch (type_)
+    {
+        case Linear:
+        {
+            return level0 + (level1 - level0) * pos;
+        }
+            
+        case Numerical:
+        {
+            if (std::abs(curve_) <= 0.001f)
+                return level0 + (level1 - level0) * pos;
+            
+            const float denom = 1.f - EnvMath::exp(curve_, accuracy);
+            const float numer = 1.f - EnvMath::exp(pos * curve_, accuracy);
+            return level0 + (level1 - level0) * (numer / denom);
+        }
+            
+        case Exponential:
+        {
+            if (! canBeExponential(level0, level1))
+                return level0 + (level1 - level0) * pos;
+            
+            return level0 * std::pow(level1 / level0, pos);
+        }
+            
+        case Sine:
+        {
+            return level0 + (level1 - level0) * (0.5f - 0.5f * std::cos(MathConstants<float>::pi * pos));
+        }
+            
+        case Welch:
+        {
+            if (level0 < level1)
+                return level0 + (level1 - level0) * std::sin(MathConstants<float>::halfPi * pos);
+            
+            return level1 + (level0 - level1) * std::cos(MathConstants<float>::halfPi * pos);
+        }
+            
+        default:
+        {
+            // Empty or Step
+            return level1;
+        }
+    }
+}
@@ -40,6 +40,8 @@
 
 #pragma once
 
+#include "EnvMath.h"
+
 #include <vector>
 
 /** Specify curved sections of breakpoint envelopes.
@@ -60,17 +62,34 @@ public:
 		Welch
 	};
 		
-	EnvCurve(float curve) throw()				: type_(Numerical), curve_(curve)			{ }
-	EnvCurve(CurveType type = Empty) throw()	: type_(type), curve_(0.f)					{ }
+	constexpr EnvCurve(float curve) throw()				: type_(Numerical), curve_(curve)			{ }
+	constexpr EnvCurve(CurveType type = Empty) throw()	: type_(type), curve_(0.f)					{ }
 		
-	CurveType getType() const throw()				{ return type_;	 }
-	float getCurve() const throw()					{ return curve_; }
-	void setType(const CurveType newType) throw()	{ type_ = newType;	 }
-	void setCurve(const float newCurve) throw()		{ curve_ = newCurve; }
+	constexpr CurveType getType() const throw()				{ return type_;	 }
+	constexpr float getCurve() const throw()					{ return curve_; }
+	constexpr void setType(const CurveType newType) throw()	{ type_ = newType;	 }
+	constexpr void setCurve(const float newCurve) throw()		{ curve_ = newCurve; }
+
+	/** Get the level at a position within a segment which has this curve.
+	 @param pos		The normalised position in the segment, 0 at the start and 1 at the end.
+	 @param level0	The level at the start of the segment.
+	 @param level1	The level at the end of the segment.
+	 @param accuracy	Whether Numerical curves use std::exp() or EnvMath::fastExp().
+	 @return		The level at that position. */
+	float interpolate(const float pos, const float level0, const float level1,
+					  const EnvMath::Accuracy accuracy = EnvMath::Exact) const throw();
+	
+	/** Returns true if an Exponential segment can go from one level to another.
+	 An exponential can't start at, end at or cross zero, everything which draws
+	 an Exponential segment uses a Linear one instead when this is false. */
+	static constexpr bool canBeExponential(const double level0, const double level1) throw()
+	{
+		return (level0 * level1) > 0.0;
+	}
 
 //    bool equalsInfinity() const throw()    { return type_ == Numerical && curve_ == INFINITY; }
     
-    bool operator==(EnvCurve const& other) const
+    constexpr bool operator==(EnvCurve const& other) const
     {
         if (type_ != other.type_)
             return false;
@@ -81,7 +100,7 @@ public:
         return true;
     }
     
-    bool operator!=(EnvCurve const& other) const { return !(*this==other); }
+    constexpr bool operator!=(EnvCurve const& other) const { return !(*this==other); }
 	
 private:
 	CurveType type_;
@@ -0,0 +1,738 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#include "EnvGen.h"
+
+
+void EnvGenSegment::prepare(const double startLevel,
+                            const double targetLevel,
+                            const EnvCurve::CurveType type,
+                            const float curve,
+                            const int64 numSamples,
+                            const double startPos,
+                            const double posIncrement) throw()
+{
+    assert(numSamples > 0);
+    
+    shape = type;
+    endLevel = targetLevel;
+    counter = numSamples;
+    grow = 0.0;
+    a2 = b1 = y1 = dy = k = 0.0;
+    
+    const double change = targetLevel - startLevel;
+    
+    if (shape == EnvCurve::Exponential && ! EnvCurve::canBeExponential(startLevel, targetLevel))
+        shape = EnvCurve::Linear;
+    
+    if (shape == EnvCurve::Numerical && std::abs(curve) <= 0.001f)
+        shape = EnvCurve::Linear;
+    
+    switch (shape)
+    {
+        case EnvCurve::Linear:
+        {
+            level = startLevel + change * startPos;
+            grow = change * posIncrement;
+        } break;
+            
+        case EnvCurve::Numerical:
+        {
+            const double a1 = change / (1.0 - std::exp((double) curve));
+            a2 = startLevel + a1;
+            b1 = a1 * std::exp(curve * startPos);
+            level = a2 - b1;
+            grow = std::exp(curve * posIncrement);
+        } break;
+            
+        case EnvCurve::Exponential:
+        {
+            const double ratio = targetLevel / startLevel;
+            level = startLevel * std::pow(ratio, startPos);
+            grow = std::pow(ratio, posIncrement);
+        } break;
+            
+        case EnvCurve::Sine:
+        {
+            // y[n] = cos(pi * pos[n]) by rotation
+            const double amplitude = change * 0.5;
+            const double phase = MathConstants<double>::pi * startPos;
+            const double w = MathConstants<double>::pi * posIncrement;
+            const double sinHalfW = std::sin(w * 0.5);
+            a2 = (targetLevel + startLevel) * 0.5;
+            k = -4.0 * sinHalfW * sinHalfW;
+            y1 = amplitude * std::cos(phase);
+            dy = -2.0 * amplitude * std::sin(phase - w * 0.5) * sinHalfW;
+            level = a2 - y1;
+        } break;
+            
+        case EnvCurve::Welch:
+        {
+            // y[n] = sin(pi/2 * pos[n]) rising or cos(pi/2 * pos[n]) falling by rotation
+            const double phase = MathConstants<double>::halfPi * startPos;
+            const double w = MathConstants<double>::halfPi * posIncrement;
+            const double sinHalfW = std::sin(w * 0.5);
+            k = -4.0 * sinHalfW * sinHalfW;
+            
+            if (targetLevel >= startLevel)
+            {
+                a2 = startLevel;
+                y1 = change * std::sin(phase);
+                dy = 2.0 * change * std::cos(phase - w * 0.5) * sinHalfW;
+            }
+            else
+            {
+                a2 = targetLevel;
+                y1 = -change * std::cos(phase);
+                dy = 2.0 * change * std::sin(phase - w * 0.5) * sinHalfW;
+            }
+            
+            level = a2 + y1;
+        } break;
+            
+        default:
+        {
+            // Empty or Step
+            level = targetLevel;
+        }
+    }
+}
+
+// The block kernels below split each recurrence into four independent lanes
+// which advance by four samples at a time. The lanes have no dependencies on
+// each other so the inner loops compile to SSE2/AVX instructions.
+
+static void processLinear(float* output, const int numSamples, double& level, const double grow) throw()
+{
+    const double start = level;
+    
+    for (int i = 0; i < numSamples; ++i)
+        output[i] = (float) (start + grow * i);
+    
+    level = start + grow * numSamples;
+}
+
+/* output[i] = offset + scale * value * ratio^i, value is updated to value * ratio^numSamples */
+static void processGeometric(float* output, const int numSamples,
+                             const double offset, const double scale,
+                             double& value, const double ratio) throw()
+{
+    double lanes[4] = { value, value * ratio, value * ratio * ratio, value * ratio * ratio * ratio };
+    const double ratio4 = (ratio * ratio) * (ratio * ratio);
+    int i = 0;
+    
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        for (int k = 0; k < 4; ++k)
+        {
+            output[i + k] = (float) (offset + scale * lanes[k]);
+            lanes[k] *= ratio4;
+        }
+    }
+    
+    double current = lanes[0];
+    
+    for (; i < numSamples; ++i)
+    {
+        output[i] = (float) (offset + scale * current);
+        current *= ratio;
+    }
+    
+    value = current;
+}
+
+/* output[i] = offset + scale * y[i] where dy[i+1] = dy[i] + k * y[i] and y[i+1] = y[i] + dy[i+1],
+   y and dy are updated to y[numSamples] and dy[numSamples] */
+static void processRotation(float* output, const int numSamples,
+                            const double offset, const double scale, const double k,
+                            double& y, double& dy) throw()
+{
+    int i = 0;
+    double current = y;
+    double difference = dy;
+    
+    if (numSamples >= 8)
+    {
+        // y[-3] to y[3] and dy[-3] to dy[3], stored at index + 3
+        double ys[7];
+        double dys[7];
+        ys[3] = y;
+        dys[3] = dy;
+        
+        for (int j = 4; j < 7; ++j)
+        {
+            dys[j] = dys[j - 1] + k * ys[j - 1];
+            ys[j] = ys[j - 1] + dys[j];
+        }
+        
+        for (int j = 2; j >= 0; --j)
+        {
+            ys[j] = ys[j + 1] - dys[j + 1];
+            dys[j] = dys[j + 1] - k * ys[j];
+        }
+        
+        // each lane steps four samples using k4 = 2cos(4w) - 2 which is found
+        // from k = 2cos(w) - 2 without cancellation, the lane differences
+        // y[n] - y[n-4] are sums of single step differences for the same reason
+        const double k2 = k * (4.0 + k);
+        const double k4 = k2 * (4.0 + k2);
+        double lanes[4];
+        double lanesDifference[4];
+        
+        for (int j = 0; j < 4; ++j)
+        {
+            lanes[j] = ys[j + 3];
+            lanesDifference[j] = (dys[j] + dys[j + 1]) + (dys[j + 2] + dys[j + 3]);
+        }
+        
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            difference += k * ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3]));
+            
+            for (int j = 0; j < 4; ++j)
+            {
+                output[i + j] = (float) (offset + scale * lanes[j]);
+                lanesDifference[j] += k4 * lanes[j];
+                lanes[j] += lanesDifference[j];
+            }
+        }
+        
+        current = lanes[0];
+    }
+    
+    for (; i < numSamples; ++i)
+    {
+        output[i] = (float) (offset + scale * current);
+        difference += k * current;
+        current += difference;
+    }
+    
+    y = current;
+    dy = difference;
+}
+
+void EnvGenSegment::process(float* output, const int numSamples) throw()
+{
+    assert(numSamples <= counter);
+    
+    switch (shape)
+    {
+        case EnvCurve::Linear:
+        {
+            processLinear(output, numSamples, level, grow);
+        } break;
+            
+        case EnvCurve::Numerical:
+        {
+            processGeometric(output, numSamples, a2, -1.0, b1, grow);
+            level = a2 - b1;
+        } break;
+            
+        case EnvCurve::Exponential:
+        {
+            processGeometric(output, numSamples, 0.0, 1.0, level, grow);
+        } break;
+            
+        case EnvCurve::Sine:
+        {
+            processRotation(output, numSamples, a2, -1.0, k, y1, dy);
+            level = a2 - y1;
+        } break;
+            
+        case EnvCurve::Welch:
+        {
+            processRotation(output, numSamples, a2, 1.0, k, y1, dy);
+            level = a2 + y1;
+        } break;
+            
+        default:
+        {
+            FloatVectorOperations::fill(output, (float) level, numSamples);
+        }
+    }
+    
+    counter -= numSamples;
+}
+
+void EnvGenSegment::render(float* output,
+                           const int numSamples,
+                           const double startLevel,
+                           const double targetLevel,
+                           const EnvCurve::CurveType type,
+                           const float curve,
+                           const double startPos,
+                           const double posIncrement) throw()
+{
+    EnvGenSegment segment;
+    segment.prepare(startLevel, targetLevel, type, curve, numSamples, startPos, posIncrement);
+    segment.process(output, numSamples);
+}
+
+EnvGen::EnvGen() throw()
+:   env_(nullptr),
+    sampleRate_(44100.0),
+    segmentIndex_(-1),
+    segmentStart_(0),
+    segmentLength_(0),
+    crossfadeRemaining_(0),
+    crossfadeLength_(0),
+    gate_(true),
+    sustaining_(false),
+    finished_(true)
+{
+    segment_.level = 0.0;
+    finish();
+}
+
+EnvGen::EnvGen(CompiledEnv const& env, const double sampleRate) throw()
+:   EnvGen()
+{
+    sampleRate_ = sampleRate;
+    setEnv(env);
+}
+
+void EnvGen::setEnv(CompiledEnv const& env) throw()
+{
+    env_ = &env;
+    reset();
+}
+
+void EnvGen::setSampleRate(const double sampleRate) throw()
+{
+    assert(sampleRate > 0.0);
+    sampleRate_ = sampleRate;
+}
+
+void EnvGen::reset() throw()
+{
+    crossfadeRemaining_ = 0;
+    finished_ = false;
+    sustaining_ = false;
+    segment_.level = env_ != nullptr ? transform_.level(env_->getFirstLevel()) : 0.0;
+    startSegment(0);
+}
+
+bool EnvGen::setGate(const bool gate) throw()
+{
+    if (gate == gate_)
+        return false;
+    
+    gate_ = gate;
+    
+    if (gate_)
+    {
+        // retrigger from the current level
+        finished_ = false;
+        sustaining_ = false;
+        startSegment(0);
+        return true;
+    }
+    
+    const int releaseNode = env_ != nullptr ? env_->getReleaseNode() : -1;
+    
+    if (releaseNode < 0 || releaseNode > env_->getNumSegments() || finished_)
+        return false;
+    
+    if (sustaining_ || segmentIndex_ < releaseNode)
+    {
+        sustaining_ = false;
+        startSegment(releaseNode);
+        return true;
+    }
+    
+    return false;
+}
+
+int64 EnvGen::timeToSamples(const double time) const throw()
+{
+    return (int64) std::llround(transform_.time(time) * sampleRate_);
+}
+
+void EnvGen::startSegment(const int index) throw()
+{
+    const int numSegments = env_ != nullptr ? env_->getNumSegments() : 0;
+    const int releaseNode = env_ != nullptr ? env_->getReleaseNode() : -1;
+    const int loopNode = env_ != nullptr ? env_->getLoopNode() : -1;
+    
+    segmentIndex_ = index;
+    
+    // the release node can be the last level, so check for it before the end
+    for (;;)
+    {
+        if (gate_ && segmentIndex_ == releaseNode)
+        {
+            const bool canLoop = loopNode >= 0
+                              && loopNode < releaseNode
+                              && timeToSamples(env_->getSegment(releaseNode - 1).endTime) > timeToSamples(env_->getSegment(loopNode).startTime);
+            
+            if (! canLoop)
+            {
+                sustain();
+                return;
+            }
+            
+            segmentIndex_ = loopNode;
+        }
+        
+        if (segmentIndex_ >= numSegments)
+            break;
+        
+        const CompiledEnv::Segment& segment = env_->getSegment(segmentIndex_);
+        const int64 numSamples = timeToSamples(segment.endTime) - timeToSamples(segment.startTime);
+        
+        if (numSamples > 0)
+        {
+            segment_.prepare(segment_.level, transform_.level(segment.level1), segment.type, segment.curve, numSamples);
+            segmentStart_ = timeToSamples(segment.startTime);
+            segmentLength_ = numSamples;
+            return;
+        }
+        
+        // shorter than a sample so jump straight to the end level
+        segment_.level = transform_.level(segment.level1);
+        ++segmentIndex_;
+    }
+    
+    finish();
+}
+
+void EnvGen::nextSegment() throw()
+{
+    if (finished_)
+    {
+        finish();
+    }
+    else if (sustaining_)
+    {
+        sustain();
+    }
+    else
+    {
+        // snap to the target so errors in the recurrences don't carry over
+        segment_.level = segment_.endLevel;
+        startSegment(segmentIndex_ + 1);
+    }
+}
+
+void EnvGen::sustain() throw()
+{
+    sustaining_ = true;
+    segmentStart_ = timeToSamples(segmentIndex_ < env_->getNumSegments() ? env_->getSegment(segmentIndex_).startTime
+                                                                         : env_->duration());
+    segmentLength_ = 0;
+    segment_.shape = EnvCurve::Step;
+    segment_.endLevel = segment_.level;
+    segment_.counter = std::numeric_limits<int64>::max();
+}
+
+void EnvGen::finish() throw()
+{
+    finished_ = true;
+    segment_.shape = EnvCurve::Step;
+    segment_.endLevel = segment_.level;
+    segment_.counter = std::numeric_limits<int64>::max();
+}
+
+void EnvGen::process(float* output, const int numSamples) throw()
+{
+    const int numToCrossfade = jmin(numSamples, crossfadeRemaining_);
+    
+    processSegments(output, numSamples);
+    
+    if (numToCrossfade > 0)
+        crossfade(output, numToCrossfade);
+}
+
+void EnvGen::processSegments(float* output, const int numSamples) throw()
+{
+    int remaining = numSamples;
+    
+    while (remaining > 0)
+    {
+        if (segment_.counter <= 0)
+            nextSegment();
+        
+        const int numToProcess = (int) jmin((int64) remaining, segment_.counter);
+        segment_.process(output, numToProcess);
+        output += numToProcess;
+        remaining -= numToProcess;
+    }
+}
+
+void EnvGen::process(float* output, const int numSamples, const Event* events, const int numEvents) throw()
+{
+    int position = 0;
+    
+    for (int i = 0; i < numEvents; ++i)
+    {
+        const int offset = jlimit(position, numSamples, events[i].sampleOffset);
+        
+        assert(i == 0 || events[i].sampleOffset >= events[i - 1].sampleOffset);
+        
+        process(output + position, offset - position);
+        position = offset;
+        applyEvent(events[i].type);
+    }
+    
+    process(output + position, numSamples - position);
+}
+
+void EnvGen::applyEvent(const Event::Type type) throw()
+{
+    switch (type)
+    {
+        case Event::GateOn:
+        {
+            setGate(true);
+        } break;
+            
+        case Event::GateOff:
+        {
+            setGate(false);
+        } break;
+            
+        case Event::Retrigger:
+        {
+            gate_ = true;
+            reset();
+        } break;
+            
+        case Event::LegatoRetrigger:
+        {
+            gate_ = true;
+            finished_ = false;
+            sustaining_ = false;
+            startSegment(0);
+        } break;
+            
+        case Event::HardReset:
+        {
+            crossfadeRemaining_ = 0;
+            gate_ = false;
+            sustaining_ = false;
+            segment_.level = env_ != nullptr ? transform_.level(env_->getFirstLevel()) : 0.0;
+            finish();
+        } break;
+    }
+}
+
+void EnvGen::swapEnv(CompiledEnv const& env, const SwapMode mode, const int crossfadeSamples) throw()
+{
+    // where we are, from the state saved when the current segment started
+    const bool wasFinished = finished_ || env_ == nullptr;
+    const bool wasSustaining = sustaining_;
+    const int64 elapsed = sustaining_ || wasFinished ? 0 : segmentLength_ - segment_.counter;
+    const int64 position = segmentStart_ + elapsed;
+    const double phase = segmentLength_ > 0 ? (double) elapsed / (double) segmentLength_ : 0.0;
+    const int oldSegmentIndex = segmentIndex_;
+    
+    if (crossfadeSamples > 0)
+    {
+        if (crossfadeRemaining_ <= 0)
+        {
+            // carry on with the old segment
+            crossfadeSegment_ = segment_;
+        }
+        else
+        {
+            // already crossfading, e.g., an EnvPublisher republishing on every drag, so
+            // hold the mix the next sample would have had and fade from that instead
+            const double oldLevel = crossfadeSegment_.counter > 0 ? crossfadeSegment_.level : crossfadeSegment_.endLevel;
+            const double gain = (double) (crossfadeLength_ - crossfadeRemaining_ + 1) / (double) (crossfadeLength_ + 1);
+            
+            crossfadeSegment_.shape = EnvCurve::Step;
+            crossfadeSegment_.level = crossfadeSegment_.endLevel = oldLevel + gain * (segment_.level - oldLevel);
+            crossfadeSegment_.counter = 0;
+        }
+        
+        crossfadeRemaining_ = crossfadeSamples;
+        crossfadeLength_ = crossfadeSamples;
+    }
+    
+    env_ = &env;
+    finished_ = false;
+    sustaining_ = false;
+    
+    const int numSegments = env_->getNumSegments();
+    const int releaseNode = env_->getReleaseNode();
+    const bool hasRelease = releaseNode >= 0 && releaseNode <= numSegments;
+    
+    int index = numSegments;
+    int64 offset = 0;
+    
+    if (wasSustaining && hasRelease && gate_)
+    {
+        index = releaseNode;
+    }
+    else if (! wasFinished)
+    {
+        if (mode == SwapBySegment)
+        {
+            index = jmax(0, oldSegmentIndex);
+            
+            if (index < numSegments)
+            {
+                const CompiledEnv::Segment& segment = env_->getSegment(index);
+                const int64 length = timeToSamples(segment.endTime) - timeToSamples(segment.startTime);
+                offset = (int64) std::floor(phase * length);
+            }
+        }
+        else
+        {
+            index = 0;
+            
+            while (index < numSegments && timeToSamples(env_->getSegment(index).endTime) <= position)
+                ++index;
+            
+            if (index < numSegments)
+                offset = position - timeToSamples(env_->getSegment(index).startTime);
+        }
+    }
+    
+    if (gate_ && hasRelease && index >= releaseNode)
+    {
+        // hold at the new release node
+        index = releaseNode;
+        offset = 0;
+    }
+    
+    if (index >= numSegments)
+    {
+        // this sustains if the release node is the last level and the gate is on
+        segment_.level = transform_.level(numSegments > 0 ? env_->getLastLevel() : env_->getFirstLevel());
+        startSegment(numSegments);
+    }
+    else
+    {
+        startSegmentAt(index, offset);
+    }
+}
+
+void EnvGen::startSegmentAt(const int index, const int64 offset) throw()
+{
+    const CompiledEnv::Segment& segment = env_->getSegment(index);
+    const int64 start = timeToSamples(segment.startTime);
+    const int64 length = timeToSamples(segment.endTime) - start;
+    
+    if (offset <= 0 || offset >= length)
+    {
+        // from the start of a segment, startSegment() deals with the release and loop nodes
+        segment_.level = transform_.level(offset <= 0 ? segment.level0 : segment.level1);
+        startSegment(offset <= 0 ? index : index + 1);
+        return;
+    }
+    
+    // part way through, follow the segment's own shape from that point
+    segmentIndex_ = index;
+    segment_.prepare(transform_.level(segment.level0), transform_.level(segment.level1),
+                     segment.type, segment.curve,
+                     length - offset, (double) offset / (double) length, 1.0 / (double) length);
+    segmentStart_ = start;
+    segmentLength_ = length;
+}
+
+float EnvGen::crossfade(const float level) throw()
+{
+    float oldLevel = (float) crossfadeSegment_.endLevel;
+    
+    if (crossfadeSegment_.counter > 0)
+        oldLevel = crossfadeSegment_.next();
+    
+    const float gain = (float) (crossfadeLength_ - --crossfadeRemaining_) / (float) (crossfadeLength_ + 1);
+    return oldLevel + gain * (level - oldLevel);
+}
+
+void EnvGen::crossfade(float* output, const int numSamples) throw()
+{
+    for (int i = 0; i < numSamples; ++i)
+        output[i] = crossfade(output[i]);
+}
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class EnvGenTests : public UnitTest
+{
+public:
+    EnvGenTests() : UnitTest("EnvGen", "EnvUGens") {}
+    
+    void runTest() override
+    {
+        beginTest("Segments longer than INT_MAX samples");
+        {
+            // 50000 seconds at 48kHz is 2.4e9 samples in one segment
+            const CompiledEnv env(Env({ 0.0, 1.0 }, { 50000.0 }));
+            EnvGen generator(env, 48000.0);
+            
+            float block[512];
+            generator.process(block, 512);
+            
+            expect(! generator.isFinished());
+            expectWithinAbsoluteError(block[511], (float) (511.0 / 2.4e9), 1.0e-9f);
+            expectWithinAbsoluteError(generator.getLevel(), (float) (512.0 / 2.4e9), 1.0e-9f);
+        }
+        
+        beginTest("Swapping again during a crossfade");
+        {
+            const CompiledEnv a(Env({ 0.0, 1.0 }, { 1.0 }));
+            const CompiledEnv b(Env({ 1.0, 0.0 }, { 1.0 }));
+            EnvGen generator(a, 1000.0);
+            
+            float output[1200];
+            generator.process(output, 500);
+            generator.swapEnv(b, EnvGen::SwapByTime, 400);
+            generator.process(output + 500, 300);
+            
+            // the same envelope again, as an EnvPublisher does while a handle is dragged
+            generator.swapEnv(b, EnvGen::SwapByTime, 400);
+            generator.process(output + 800, 400);
+            
+            float maxStep = 0.f;
+            
+            for (int i = 1; i < 1200; ++i)
+                maxStep = jmax(maxStep, std::abs(output[i] - output[i - 1]));
+            
+            expectLessOrEqual(maxStep, 0.005f);
+            expect(! generator.isCrossfading());
+            expectEquals(generator.getNextSample(), 0.f);
+        }
+    }
+};
+
+static EnvGenTests envGenTests;
+
+#endif
@@ -0,0 +1,287 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#pragma once
+
+#include "CompiledEnv.h"
+
+/** The per-sample state of one envelope segment.
+ 
+ This uses the same recurrences as SuperCollider's EnvGen so that each sample
+ costs one multiply-add for Linear, Numerical and Exponential shapes and a
+ second order (rotation) update for Sine and Welch shapes, with no calls to
+ transcendental functions after prepare().
+ 
+ The rotation is kept as a value and its difference from the previous sample
+ (y1 and dy) with k = 2cos(w) - 2 rather than SuperCollider's two previous
+ values and 2cos(w) since 2cos(w) cannot represent very small angles, which
+ would distort the shape of segments lasting minutes or hours.
+ 
+ @ingroup EnvUGens
+ @see EnvGen */
+struct EnvGenSegment
+{
+    /** Sets up the recurrence to move from one level to another.
+     @param startLevel  The level at the start of the segment.
+     @param targetLevel The level at the end of the segment.
+     @param type        The curve type of the segment.
+     @param curve       The curve value for Numerical segments.
+     @param numSamples  The duration of the segment in samples. */
+    void prepare(const double startLevel,
+                 const double targetLevel,
+                 const EnvCurve::CurveType type,
+                 const float curve,
+                 const int64 numSamples) throw()
+    {
+        prepare(startLevel, targetLevel, type, curve, numSamples, 0.0, 1.0 / (double) numSamples);
+    }
+    
+    /** Sets up the recurrence to step through part of a segment.
+     The closed form shape of the segment is sampled at startPos, startPos + posIncrement,
+     startPos + 2 * posIncrement and so on where the positions are normalised to the
+     duration of the whole segment.
+     @param startLevel      The level at the start of the whole segment.
+     @param targetLevel     The level at the end of the whole segment.
+     @param type            The curve type of the segment.
+     @param curve           The curve value for Numerical segments.
+     @param numSamples      The number of samples to step through.
+     @param startPos        The normalised position of the first sample.
+     @param posIncrement    The normalised distance between samples. */
+    void prepare(const double startLevel,
+                 const double targetLevel,
+                 const EnvCurve::CurveType type,
+                 const float curve,
+                 const int64 numSamples,
+                 const double startPos,
+                 const double posIncrement) throw();
+    
+    /** Returns the current level and advances by one sample. */
+    inline float next() throw()
+    {
+        const float output = (float) level;
+        
+        switch (shape)
+        {
+            case EnvCurve::Linear:      level += grow;                                          break;
+            case EnvCurve::Numerical:   b1 *= grow; level = a2 - b1;                            break;
+            case EnvCurve::Exponential: level *= grow;                                          break;
+            case EnvCurve::Sine:        dy += k * y1; y1 += dy; level = a2 - y1;                break;
+            case EnvCurve::Welch:       dy += k * y1; y1 += dy; level = a2 + y1;                break;
+            default:                                                                            break;
+        }
+        
+        --counter;
+        return output;
+    }
+    
+    /** Writes numSamples samples of the segment, this must not be more than counter. */
+    void process(float* output, const int numSamples) throw();
+    
+    /** Writes part of a segment sampled at regularly spaced positions.
+     This is prepare() followed by process() and takes the same arguments. */
+    static void render(float* output,
+                       const int numSamples,
+                       const double startLevel,
+                       const double targetLevel,
+                       const EnvCurve::CurveType type,
+                       const float curve,
+                       const double startPos,
+                       const double posIncrement) throw();
+    
+    EnvCurve::CurveType shape;
+    double level;
+    double endLevel;
+    double grow;
+    double a2, b1;
+    double y1, dy, k;
+    int64 counter;      ///< 64-bit so a single segment can last longer than INT_MAX samples.
+};
+
+/** Plays a CompiledEnv one sample at a time.
+ 
+ This is a stateful alternative to calling lookup() for every sample: the
+ generator advances segment by segment using the recurrences in EnvGenSegment
+ so only the segment changes cost more than a few arithmetic operations.
+ 
+ The generator has a gate, like SuperCollider's EnvGen. While the gate is on
+ the envelope sustains when it reaches the release node or, if there is a loop
+ node before the release node, loops the segments between the loop node and
+ the release node. Turning the gate off moves straight to the segment after the
+ release node from the current level. Turning the gate on again restarts the
+ envelope from the current level. The gate is on by default.
+ 
+ Segment boundaries are rounded from the envelope's cumulative times so the
+ rounding errors do not accumulate over the segments, or over the iterations of
+ a loop, and each segment finishes exactly on its target level.
+ 
+ The CompiledEnv is not copied and must remain valid while the EnvGen uses it.
+ 
+ @ingroup EnvUGens
+ @see Env CompiledEnv */
+class EnvGen
+{
+public:
+    /** A change to the generator at a particular sample in a block.
+     @see process */
+    struct Event
+    {
+        enum Type
+        {
+            GateOn,             ///< Opens the gate, as setGate(true).
+            GateOff,            ///< Closes the gate, as setGate(false).
+            Retrigger,          ///< Jumps to the first level and restarts with the gate on.
+            LegatoRetrigger,    ///< Restarts from the current level with the gate on.
+            HardReset           ///< Jumps to the first level and stops with the gate off.
+        };
+        
+        int sampleOffset;       ///< The sample in the block from which the event applies.
+        Type type;
+    };
+    
+    /** How swapEnv() finds the position in the new envelope. */
+    enum SwapMode
+    {
+        SwapByTime,         ///< The same time from the start of the envelope.
+        SwapBySegment       ///< The same segment at the same proportion of its duration.
+    };
+    
+    EnvGen() throw();
+    EnvGen(CompiledEnv const& env, const double sampleRate) throw();
+    
+    /** Sets the envelope to play, this also resets the generator. */
+    void setEnv(CompiledEnv const& env) throw();
+    
+    /** Replaces the envelope while it is playing without jumping.
+     The current position is mapped into the new envelope and the output crossfades
+     from the old envelope to the new one. During the crossfade the old envelope's
+     current segment carries on (holding its target level if it ends) so the old
+     envelope itself is not used and can already have been overwritten, e.g., by
+     an EnvPublisher. Swapping again during a crossfade fades from the current mix
+     of the two, which is held at its level. The gate is kept so, while it is on, a
+     position at or after the new release node sustains there.
+     @param env                 The new envelope, this is not copied.
+     @param mode                How to map the current position into the new envelope.
+     @param crossfadeSamples    The length of the crossfade, 0 jumps straight to the new envelope. */
+    void swapEnv(CompiledEnv const& env, const SwapMode mode = SwapByTime, const int crossfadeSamples = 64) throw();
+    
+    /** Returns true while swapEnv() is crossfading. */
+    inline bool isCrossfading() const throw()   { return crossfadeRemaining_ > 0; }
+    
+    /** Sets the sample rate used to convert the envelope times to samples. */
+    void setSampleRate(const double sampleRate) throw();
+    
+    /** Sets a scaling for the levels and times of the envelope.
+     This lets one CompiledEnv be played with per-note velocity or key tracking
+     without copying it. It applies from the next segment that starts so it is
+     usually set before reset() or retriggering. */
+    inline void setTransform(EnvTransform const& transform) throw()   { transform_ = transform; }
+    
+    inline EnvTransform const& getTransform() const throw()             { return transform_; }
+    
+    /** Restarts the envelope from its first level. */
+    void reset() throw();
+    
+    /** Opens or closes the gate, this takes effect from the next sample.
+     @return    true if this started a new segment. */
+    bool setGate(const bool gate) throw();
+    
+    inline bool getGate() const throw()         { return gate_; }
+    
+    /** Returns true while the envelope is holding at its release node. */
+    inline bool isSustaining() const throw()    { return sustaining_; }
+    
+    /** Returns the current level and advances by one sample. */
+    inline float getNextSample() throw()
+    {
+        if (segment_.counter <= 0)
+            nextSegment();
+        
+        const float level = segment_.next();
+        return crossfadeRemaining_ > 0 ? crossfade(level) : level;
+    }
+    
+    /** Writes the next numSamples samples of the envelope. */
+    void process(float* output, const int numSamples) throw();
+    
+    /** Writes the next numSamples samples of the envelope applying events at exact samples.
+     The output is not split by the caller, each event applies from the sample at its
+     offset in the block (the sample written at that offset already reflects the event).
+     @param output      The buffer to write to.
+     @param numSamples  The number of samples to write.
+     @param events      The events, these must be sorted by sampleOffset.
+     @param numEvents   The number of events. Events with offsets at or after numSamples
+                        are applied after the last sample. */
+    void process(float* output, const int numSamples, const Event* events, const int numEvents) throw();
+    
+    /** Applies an event immediately. */
+    void applyEvent(const Event::Type type) throw();
+    
+    /** Returns true once the last segment has finished. */
+    inline bool isFinished() const throw()      { return finished_; }
+    
+    /** Returns the level that the next sample will have, ignoring any crossfade. */
+    inline float getLevel() const throw()       { return (float) segment_.level; }
+    
+    inline int getSegmentIndex() const throw()  { return segmentIndex_; }
+    
+    friend class EnvVoiceBank;
+    
+private:
+    void startSegment(const int index) throw();
+    void startSegmentAt(const int index, const int64 offset) throw();
+    float crossfade(const float level) throw();
+    void crossfade(float* output, const int numSamples) throw();
+    void processSegments(float* output, const int numSamples) throw();
+    void nextSegment() throw();
+    void sustain() throw();
+    void finish() throw();
+    int64 timeToSamples(const double time) const throw();
+    
+    const CompiledEnv* env_;
+    EnvTransform transform_;
+    double sampleRate_;
+    EnvGenSegment segment_;
+    int segmentIndex_;
+    int64 segmentStart_;        ///< The sample in the envelope at which the current segment starts.
+    int64 segmentLength_;       ///< The length of the current segment in samples.
+    EnvGenSegment crossfadeSegment_;
+    int crossfadeRemaining_;
+    int crossfadeLength_;
+    bool gate_;
+    bool sustaining_;
+    bool finished_;
+};
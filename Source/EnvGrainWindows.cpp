@@ -0,0 +1,114 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#include "EnvGrainWindows.h"
+
+
+EnvGrainWindowReader::EnvGrainWindowReader() throw()
+:   table_(nullptr),
+    phase_(1.0),
+    increment_(0.0),
+    mipLevel_(0)
+{
+}
+
+void EnvGrainWindowReader::start(EnvTable const& table, const double numSamples, const double startPhase) throw()
+{
+    assert(numSamples > 0.0);
+    
+    table_ = &table;
+    phase_ = startPhase;
+    increment_ = 1.0 / numSamples;
+    mipLevel_ = table.getMipLevel(increment_);
+}
+
+int EnvGrainWindowReader::getNumSamplesRemaining(const int numSamples) const throw()
+{
+    if (isFinished())
+        return 0;
+    
+    return (int) jmin((double) numSamples, std::ceil((1.0 - phase_) / increment_));
+}
+
+void EnvGrainWindowReader::process(float* output, const int numSamples) throw()
+{
+    const int count = getNumSamplesRemaining(numSamples);
+    
+    for (int i = 0; i < count; ++i)
+        output[i] = getNextSample();
+    
+    if (count < numSamples)
+    {
+        FloatVectorOperations::clear(output + count, numSamples - count);
+        phase_ = 1.0;
+    }
+}
+
+void EnvGrainWindowReader::applyTo(float* samples, const int numSamples) throw()
+{
+    const int count = getNumSamplesRemaining(numSamples);
+    
+    for (int i = 0; i < count; ++i)
+        samples[i] *= getNextSample();
+    
+    if (count < numSamples)
+    {
+        FloatVectorOperations::clear(samples + count, numSamples - count);
+        phase_ = 1.0;
+    }
+}
+
+
+EnvGrainWindows::EnvGrainWindows(const int tableSize, const double linenSustain, EnvTableCache& cache) throw()
+:   cache_(cache),
+    tableSize_(tableSize)
+{
+    assert(linenSustain >= 0.0 && linenSustain < 1.0);
+    
+    const double linenRamp = (1.0 - linenSustain) * 0.5;
+    
+    windows_.resize(NumShapes);
+    windows_[Sine] = cache_.getTable(Env::sine(1.0), tableSize_);
+    windows_[Triangle] = cache_.getTable(Env::triangle(1.0), tableSize_);
+    windows_[Linen] = cache_.getTable(Env::linen(linenRamp, linenSustain, linenRamp), tableSize_);
+}
+
+int EnvGrainWindows::addWindow(Env const& env) throw()
+{
+    windows_.push_back(cache_.getTable(env, tableSize_));
+    return getNumWindows() - 1;
+}
@@ -0,0 +1,140 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#pragma once
+
+#include "EnvTable.h"
+
+/** Reads a grain window from an EnvTable at a per-grain rate.
+ 
+ This is a small value type which can be kept per grain, starting a grain does
+ not allocate and each sample costs one interpolated table read. The mip level
+ of the table is chosen once when the grain starts so short grains read from a
+ suitably smoothed table.
+ 
+ @ingroup EnvUGens
+ @see EnvGrainWindows */
+class EnvGrainWindowReader
+{
+public:
+    EnvGrainWindowReader() throw();
+    
+    /** Starts reading a window.
+     @param table       The window, this must stay alive while the grain plays.
+     @param numSamples  The length of the grain in samples.
+     @param startPhase  The phase to start from, 0 is the start of the window and 1 the end. */
+    void start(EnvTable const& table, const double numSamples, const double startPhase = 0.0) throw();
+    
+    /** Returns true once the whole window has been read. */
+    inline bool isFinished() const throw()      { return phase_ >= 1.0; }
+    
+    /** Returns the next sample of the window, this must not be called once the window is finished. */
+    inline float getNextSample() throw()
+    {
+        const float level = table_->read(mipLevel_, phase_);
+        phase_ += increment_;
+        return level;
+    }
+    
+    /** Writes the next numSamples samples of the window, with zeros after it finishes. */
+    void process(float* output, const int numSamples) throw();
+    
+    /** Multiplies a buffer by the next numSamples samples of the window, with zeros after it finishes. */
+    void applyTo(float* samples, const int numSamples) throw();
+    
+private:
+    int getNumSamplesRemaining(const int numSamples) const throw();
+    
+    const EnvTable* table_;
+    double phase_;
+    double increment_;
+    int mipLevel_;
+};
+
+/** A set of grain windows baked once and shared by every grain.
+ 
+ The standard windows are baked from Env::sine(), Env::triangle() and Env::linen()
+ with a duration of 1 and a peak of 1, any other Env can be added as a window too.
+ The tables come from an EnvTableCache so instances with the same windows share
+ them. Grains then read the windows by phase with an EnvGrainWindowReader, no Env
+ is constructed or scaled per grain.
+ 
+ @code
+ EnvGrainWindows windows;
+ EnvGrainWindowReader reader;
+ reader.start(windows.getWindow(EnvGrainWindows::Sine), grainLengthInSamples);
+ reader.applyTo(grainSamples, numSamples);
+ @endcode
+ 
+ @ingroup EnvUGens
+ @see EnvGrainWindowReader EnvTable */
+class EnvGrainWindows
+{
+public:
+    enum Shape
+    {
+        Sine,
+        Triangle,
+        Linen,
+        NumShapes
+    };
+    
+    /** Bakes the standard windows.
+     @param tableSize       The number of intervals in each table.
+     @param linenSustain    The proportion of the Linen window which is sustained at 1,
+                            the rest is split equally between the attack and release.
+     @param cache           The cache to take the tables from. */
+    EnvGrainWindows(const int tableSize = 1024,
+                    const double linenSustain = 0.5,
+                    EnvTableCache& cache = EnvTableCache::getDefault()) throw();
+    
+    /** Adds an envelope as a window and returns its index.
+     The whole duration of the envelope is read over the length of each grain, its
+     levels are used as they are. This may bake a table so should not be called on
+     the audio thread. */
+    int addWindow(Env const& env) throw();
+    
+    inline int getNumWindows() const throw()                      { return (int) windows_.size(); }
+    
+    /** Returns one of the standard windows or one added with addWindow(). */
+    inline EnvTable const& getWindow(const int index) const throw() { return *windows_[index]; }
+    
+private:
+    EnvTableCache& cache_;
+    int tableSize_;
+    std::vector<std::shared_ptr<const EnvTable>> windows_;
+};
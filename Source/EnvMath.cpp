@@ -0,0 +1,96 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#include "EnvMath.h"
+
+
+//==============================================================================
+#if JUCE_UNIT_TESTS
+
+class EnvMathTests : public UnitTest
+{
+public:
+    EnvMathTests() : UnitTest("EnvMath", "EnvUGens") {}
+    
+    void runTest() override
+    {
+        beginTest("fastExp error bound");
+        {
+            // the documented bound is measured at every float, this samples the range evenly
+            const int numPoints = 1000000;
+            double maxError = 0.0;
+            
+            for (int i = 0; i <= numPoints; ++i)
+            {
+                const float x = -87.f + 175.f * (float) i / (float) numPoints;
+                const double error = std::abs((double) EnvMath::fastExp(x) / std::exp((double) x) - 1.0);
+                maxError = jmax(maxError, error);
+            }
+            
+            expectLessOrEqual(maxError, 2.6e-7);
+        }
+        
+        beginTest("fastExp clamps large arguments");
+        {
+            const float high = EnvMath::fastExp(88.f);
+            const float low = EnvMath::fastExp(-87.f);
+            const float infinity = std::numeric_limits<float>::infinity();
+            
+            expectEquals(EnvMath::fastExp(100.f), high);
+            expectEquals(EnvMath::fastExp(1.0e9f), high);
+            expectEquals(EnvMath::fastExp(infinity), high);
+            expectEquals(EnvMath::fastExp(-100.f), low);
+            expectEquals(EnvMath::fastExp(-1.0e9f), low);
+            expectEquals(EnvMath::fastExp(-infinity), low);
+            expect(std::isfinite(high));
+            expectGreaterThan(low, 0.f);
+        }
+        
+        beginTest("fastExp of a NaN");
+        {
+            const float nan = std::numeric_limits<float>::quiet_NaN();
+            
+            expect(std::isfinite(EnvMath::fastExp(nan)));
+            expect(std::isfinite(EnvMath::fastExp(-nan)));
+            expectGreaterThan(EnvMath::fastExp(-nan), 0.f);
+        }
+    }
+};
+
+static EnvMathTests envMathTests;
+
+#endif
@@ -0,0 +1,99 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#pragma once
+
+#include "JuceHeader.h"
+
+#include <cmath>
+#include <cstring>
+
+/** Approximations of the transcendental functions used to evaluate envelope curves.
+ 
+ @ingroup EnvUGens
+ @see CompiledEnv EnvCurve */
+struct EnvMath
+{
+    /** How precisely curves are evaluated when they need transcendental functions. */
+    enum Accuracy
+    {
+        Exact,      ///< Uses the standard library, e.g., for offline rendering.
+        Fast        ///< Uses the approximations below, e.g., for live voices.
+    };
+    
+    /** A fast approximation of exp() for floats.
+     
+     The argument is reduced to r = x - n * log(2) with |r| <= log(2) / 2 (in two
+     parts so the reduction is exact), exp(r) is evaluated with a degree 6 polynomial
+     and 2^n is built directly in the exponent bits. There are no branches, table
+     lookups or library calls so loops of this vectorise.
+     
+     The maximum relative error is 2.6e-7 (about two ulps) for all x in [-87, 88],
+     measured against double precision exp() at every float in that range. Outside
+     that range x is clamped so the result is exp(-87) or exp(88), finite and
+     non-zero but not accurate (a NaN is clamped the same way). */
+    static inline float fastExp(float x) throw()
+    {
+        // the clamp is done on the magnitude bits, float comparisons would stop
+        // loops vectorising unless floating point traps are disabled
+        int32 xBits;
+        std::memcpy(&xBits, &x, sizeof(x));
+        const int32 limit = xBits < 0 ? 0x42ae0000 /* 87.f */ : 0x42b00000 /* 88.f */;
+        xBits = (xBits & ~0x7fffffff) | jmin(xBits & 0x7fffffff, limit);
+        std::memcpy(&x, &xBits, sizeof(x));
+        
+        // adding and subtracting 1.5 * 2^23 rounds to the nearest integer without a function call
+        const float n = (x * 1.44269504f + 12582912.f) - 12582912.f;
+        const float r = (x - n * 0.693145752f) - n * 1.42860677e-6f;
+        
+        const float p = 1.f + r * (1.f + r * (0.5f + r * (1.66666667e-1f + r * (4.16666667e-2f
+                                                        + r * (8.33333333e-3f + r * 1.38888889e-3f)))));
+        
+        // with x clamped n + 127 is a normal exponent, 1 to 254
+        const int32 bits = ((int32) n + 127) << 23;
+        float scale;
+        std::memcpy(&scale, &bits, sizeof(scale));
+        
+        return p * scale;
+    }
+    
+    /** Returns exp(x) with a given accuracy. */
+    static inline float exp(const float x, const Accuracy accuracy) throw()
+    {
+        return accuracy == Fast ? fastExp(x) : std::exp(x);
+    }
+};
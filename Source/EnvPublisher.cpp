@@ -0,0 +1,71 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#include "EnvPublisher.h"
+
+
+EnvPublisher::EnvPublisher(const double sampleRate) throw()
+:   sampleRate_(sampleRate),
+    back_(2),
+    front_(0),
+    middle_(1)
+{
+}
+
+void EnvPublisher::publish(Env const& env) throw()
+{
+    CompiledEnv& buffer = buffers_[back_];
+    
+    // a buffer keeps its sample rate when it is recompiled
+    if (sampleRate_ > 0.0 && buffer.getSampleRate() != sampleRate_)
+        buffer.setSampleRate(sampleRate_);
+    
+    buffer.compile(env);
+    
+    // the release makes the compiled envelope visible to the reader, the acquire
+    // makes sure the reader has finished with the buffer we get back
+    back_ = middle_.exchange(back_ | newFlag, std::memory_order_acq_rel) & indexMask;
+}
+
+bool EnvPublisher::update() throw()
+{
+    if ((middle_.load(std::memory_order_relaxed) & newFlag) == 0)
+        return false;
+    
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & indexMask;
+    return true;
+}
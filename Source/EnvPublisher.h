@@ -0,0 +1,99 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#pragma once
+
+#include "CompiledEnv.h"
+
+#include <atomic>
+
+/** Hands envelopes from one thread (usually the message thread) to another
+ (usually the audio thread) without locking.
+ 
+ This is a triple buffer of CompiledEnv objects: the publishing thread compiles
+ into a back buffer and swaps it into the middle with a single atomic exchange,
+ the reading thread swaps the middle into the front when there is something new.
+ Neither thread ever waits for the other, the reader always sees a complete
+ envelope and nothing is allocated or freed on the reading thread, once the
+ buffers have grown to the size of the envelopes they are compiled again in place.
+ 
+ There must be only one publishing thread and one reading thread.
+ 
+ @ingroup EnvUGens
+ @see CompiledEnv EnvelopeComponentPublisher */
+class EnvPublisher
+{
+public:
+    /** Creates a publisher.
+     @param sampleRate  If greater than zero, each envelope is published with
+                        CompiledEnv::setSampleRate() already applied. */
+    explicit EnvPublisher(const double sampleRate = 0.0) throw();
+    
+    /** Sets the sample rate applied to envelopes published from now on.
+     CompiledEnv::setSampleRate() allocates so it can't be called on the reading
+     thread, set it here to use the sample-accurate functions of getCurrent().
+     This is called on the publishing thread. */
+    inline void setSampleRate(const double sampleRate) throw()    { sampleRate_ = sampleRate; }
+    inline double getSampleRate() const throw()                   { return sampleRate_; }
+    
+    /** Compiles an envelope and makes it the latest one.
+     This is called on the publishing thread, it may allocate while the buffers grow. */
+    void publish(Env const& env) throw();
+    
+    /** Takes the latest published envelope if there is one that hasn't been taken.
+     This is called on the reading thread and is wait-free.
+     @return    true if getCurrent() has changed, the previous envelope may then be
+                overwritten by the publishing thread and must not be used again. */
+    bool update() throw();
+    
+    /** Returns the envelope taken by the last call to update().
+     This must only be used on the reading thread. */
+    inline CompiledEnv const& getCurrent() const throw()  { return buffers_[front_]; }
+    
+private:
+    enum
+    {
+        indexMask = 3,
+        newFlag = 4     ///< Set in middle_ when it holds an envelope the reader hasn't taken.
+    };
+    
+    CompiledEnv buffers_[3];
+    double sampleRate_;         ///< Only used by the publishing thread.
+    int back_;                  ///< Only used by the publishing thread.
+    int front_;                 ///< Only used by the reading thread.
+    std::atomic<int> middle_;
+};
@@ -0,0 +1,189 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#include "EnvTable.h"
+
+
+EnvTable::EnvTable(Env const& env, const int size) throw()
+:   env_(env),
+    size_(nextPowerOfTwo(jmax(1, size))),
+    duration_(env.duration()),
+    reciprocalDuration_(duration_ > 0.0 ? 1.0 / duration_ : 0.0)
+{
+    // the full resolution table and then each mip level has half the intervals
+    int totalSize = 0;
+    
+    for (int numIntervals = size_; numIntervals > 0; numIntervals >>= 1)
+    {
+        offsets_.push_back(totalSize);
+        totalSize += numIntervals + 1;
+    }
+    
+    data_.resize(totalSize);
+    float* data = data_.data();
+    
+    if (duration_ > 0.0)
+    {
+        env.render(data, size_ + 1, size_ * reciprocalDuration_);
+    }
+    else
+    {
+        data[0] = env.lookup(0.f);
+        std::fill(data + 1, data + size_ + 1, env.lookup(1.f));
+    }
+    
+    for (int level = 1; level < getNumMipLevels(); ++level)
+    {
+        const float* source = data_.data() + offsets_[level - 1];
+        float* destination = data_.data() + offsets_[level];
+        const int numIntervals = size_ >> level;
+        
+        // a [1 2 1] / 4 filter keeping the end points exact
+        destination[0] = source[0];
+        destination[numIntervals] = source[numIntervals * 2];
+        
+        for (int i = 1; i < numIntervals; ++i)
+            destination[i] = 0.25f * source[i * 2 - 1] + 0.5f * source[i * 2] + 0.25f * source[i * 2 + 1];
+    }
+}
+
+int EnvTable::getMipLevel(const double phaseIncrement) const throw()
+{
+    // the number of full resolution intervals skipped between reads
+    const double step = std::abs(phaseIncrement) * size_;
+    
+    if (step < 2.0)
+        return 0;
+    
+    int exponent;
+    std::frexp(step, &exponent);
+    return jmin(exponent - 1, getNumMipLevels() - 1);
+}
+
+float EnvTable::lookup(const double phase, const double phaseIncrement) const throw()
+{
+    return read(getMipLevel(phaseIncrement), phase);
+}
+
+
+EnvTableCache::EnvTableCache(const int maxNumUnusedTablesToKeep) throw()
+:   maxNumUnusedTables(maxNumUnusedTablesToKeep)
+{
+}
+
+EnvTableCache& EnvTableCache::getDefault() throw()
+{
+    static EnvTableCache cache;
+    return cache;
+}
+
+std::shared_ptr<const EnvTable> EnvTableCache::findTable(Env const& env, const uint64 hash, const int size) throw()
+{
+    for (auto entry = entries.begin(); entry != entries.end(); ++entry)
+    {
+        if (entry->hash == hash && entry->table->getSize() == size && entry->table->getEnv() == env)
+        {
+            auto table = entry->table;
+            
+            // keep the most recently used tables at the end
+            std::rotate(entry, entry + 1, entries.end());
+            return table;
+        }
+    }
+    
+    return nullptr;
+}
+
+std::shared_ptr<const EnvTable> EnvTableCache::getTable(Env const& env, const int size) throw()
+{
+    const uint64 hash = env.hashCode();
+    const int tableSize = nextPowerOfTwo(jmax(1, size));
+    
+    {
+        const ScopedLock sl (lock);
+        
+        if (auto table = findTable(env, hash, tableSize))
+            return table;
+    }
+    
+    // bake without holding the lock, another thread may have baked the same table meanwhile
+    auto newTable = std::make_shared<const EnvTable>(env, tableSize);
+    
+    const ScopedLock sl (lock);
+    
+    if (auto table = findTable(env, hash, tableSize))
+        return table;
+    
+    entries.push_back({ hash, newTable });
+    removeUnusedTables();
+    return newTable;
+}
+
+void EnvTableCache::removeUnusedTables() throw()
+{
+    int numUnused = 0;
+    
+    for (auto const& entry : entries)
+        if (entry.table.use_count() == 1)
+            ++numUnused;
+    
+    // the least recently used tables are at the start
+    for (auto entry = entries.begin(); entry != entries.end() && numUnused > maxNumUnusedTables;)
+    {
+        if (entry->table.use_count() == 1)
+        {
+            entry = entries.erase(entry);
+            --numUnused;
+        }
+        else
+        {
+            ++entry;
+        }
+    }
+}
+
+int EnvTableCache::getNumTables() const throw()
+{
+    const ScopedLock sl (lock);
+    return (int) entries.size();
+}
+
+void EnvTableCache::clear() throw()
+{
+    const ScopedLock sl (lock);
+    entries.clear();
+}
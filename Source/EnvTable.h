@@ -0,0 +1,158 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#pragma once
+
+#include "Env.h"
+
+#include <memory>
+
+/** An envelope baked into a table for fast interpolated reading.
+ 
+ The table holds the envelope sampled at size + 1 evenly spaced points from time
+ zero to its duration, followed by a small mip pyramid: each smaller table has
+ half the number of intervals and is low-pass filtered from the one above, so
+ reading with a large phase increment (e.g., a short grain or a fast modulation
+ rate) does not skip over parts of the shape.
+ 
+ Tables are read with a normalised phase from 0 to 1 and linear interpolation.
+ Reading does not allocate or lock so it can be done on the audio thread, use
+ EnvTableCache to share tables between voices.
+ 
+ @ingroup EnvUGens
+ @see Env EnvTableCache */
+class EnvTable
+{
+public:
+    /** Bakes an envelope into a table.
+     @param env     The envelope, its loop and release nodes are ignored.
+     @param size    The number of intervals in the full resolution table, this is
+                    rounded up to a power of two. */
+    EnvTable(Env const& env, const int size = 1024) throw();
+    
+    /** Returns the envelope that was baked. */
+    inline Env const& getEnv() const throw()                  { return env_; }
+    
+    /** Returns the number of intervals in the full resolution table. */
+    inline int getSize() const throw()                          { return size_; }
+    
+    /** Returns the number of tables including the full resolution table. */
+    inline int getNumMipLevels() const throw()                  { return (int) offsets_.size(); }
+    
+    /** Returns the duration of the envelope that was baked. */
+    inline double getDuration() const throw()                   { return duration_; }
+    
+    /** Reads the full resolution table.
+     @param phase   The position from 0 (the start of the envelope) to 1 (the end),
+                    positions outside this range are clamped. */
+    inline float lookup(const double phase) const throw()       { return read(0, phase); }
+    
+    /** Reads the table with a resolution suited to the rate of reading.
+     @param phase           The position from 0 to 1.
+     @param phaseIncrement  The change in phase between reads. */
+    float lookup(const double phase, const double phaseIncrement) const throw();
+    
+    /** Reads the full resolution table at a time from the start of the envelope. */
+    inline float lookupTime(const double time) const throw()    { return read(0, time * reciprocalDuration_); }
+    
+    /** Returns the mip level used for a phase increment, 0 is full resolution. */
+    int getMipLevel(const double phaseIncrement) const throw();
+    
+    /** Reads one of the tables with linear interpolation. */
+    inline float read(const int mipLevel, const double phase) const throw()
+    {
+        const int numIntervals = size_ >> mipLevel;
+        const float* data = data_.data() + offsets_[mipLevel];
+        const double position = jlimit(0.0, (double) numIntervals, phase * numIntervals);
+        const int index = jmin((int) position, numIntervals - 1);
+        const float fraction = (float) (position - index);
+        
+        return data[index] + fraction * (data[index + 1] - data[index]);
+    }
+    
+private:
+    Env env_;
+    int size_;
+    double duration_;
+    double reciprocalDuration_;
+    std::vector<float> data_;
+    std::vector<int> offsets_;
+};
+
+/** A shared cache of EnvTable objects keyed on the contents of the envelopes.
+ 
+ Identical envelopes, e.g., the same shape used by many voices, are baked once
+ and share one table. Tables stay alive while anything holds them, the cache
+ also keeps up to a maximum number of unused tables in case they are asked for
+ again.
+ 
+ getTable() may bake a table and locks so it should be called when a voice or
+ grain stream is set up rather than on the audio thread.
+ 
+ @ingroup EnvUGens
+ @see EnvTable */
+class EnvTableCache
+{
+public:
+    EnvTableCache(const int maxNumUnusedTables = 16) throw();
+    
+    /** Returns the cache shared by everything in the process. */
+    static EnvTableCache& getDefault() throw();
+    
+    /** Returns a table for an envelope, baking it if there isn't one for an equal envelope of the same size. */
+    std::shared_ptr<const EnvTable> getTable(Env const& env, const int size = 1024) throw();
+    
+    /** Returns the number of tables in the cache, used or not. */
+    int getNumTables() const throw();
+    
+    /** Removes all the tables from the cache, tables in use stay alive until they are released. */
+    void clear() throw();
+    
+private:
+    struct Entry
+    {
+        uint64 hash;
+        std::shared_ptr<const EnvTable> table;
+    };
+    
+    std::shared_ptr<const EnvTable> findTable(Env const& env, const uint64 hash, const int size) throw();
+    void removeUnusedTables() throw();
+    
+    CriticalSection lock;
+    std::vector<Entry> entries;
+    int maxNumUnusedTables;
+};
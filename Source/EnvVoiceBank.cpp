@@ -0,0 +1,215 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#include "EnvVoiceBank.h"
+
+
+EnvVoiceBank::EnvVoiceBank(const int numVoices, const double sampleRate) throw()
+:   numVoices_(numVoices),
+    numVoicesPadded_((numVoices + voiceAlignment - 1) / voiceAlignment * voiceAlignment),
+    sampleRate_(sampleRate),
+    generators_(numVoices),
+    level_(numVoicesPadded_, 0.0),
+    mult_(numVoicesPadded_, 1.0),
+    add_(numVoicesPadded_, 0.0),
+    sign_(numVoicesPadded_, 0.0),
+    k_(numVoicesPadded_, 0.0),
+    y_(numVoicesPadded_, 0.0),
+    dy_(numVoicesPadded_, 0.0),
+    counter_(numVoicesPadded_, std::numeric_limits<int64>::max()),
+    finished_(numVoicesPadded_, 1),
+    block_(blockSize * numVoicesPadded_, 0.0)
+{
+    assert(numVoices > 0);
+    
+    for (int voice = 0; voice < numVoices_; ++voice)
+        generators_[voice].setSampleRate(sampleRate_);
+}
+
+void EnvVoiceBank::setSampleRate(const double sampleRate) throw()
+{
+    assert(sampleRate > 0.0);
+    sampleRate_ = sampleRate;
+}
+
+void EnvVoiceBank::load(const int voice) throw()
+{
+    const EnvGen& generator = generators_[voice];
+    const EnvGenSegment& segment = generator.segment_;
+    
+    level_[voice] = segment.level;
+    counter_[voice] = segment.counter;
+    finished_[voice] = generator.finished_ ? 1 : 0;
+    mult_[voice] = 1.0;
+    add_[voice] = 0.0;
+    sign_[voice] = 0.0;
+    k_[voice] = y_[voice] = dy_[voice] = 0.0;
+    
+    switch (segment.shape)
+    {
+        case EnvCurve::Linear:
+        {
+            add_[voice] = segment.grow;
+        } break;
+            
+        case EnvCurve::Numerical:
+        {
+            // level = a2 - b1 and b1 *= grow, so level = grow * level + a2 * (1 - grow)
+            mult_[voice] = segment.grow;
+            add_[voice] = (segment.a2 * (1.0 - segment.grow));
+        } break;
+            
+        case EnvCurve::Exponential:
+        {
+            mult_[voice] = segment.grow;
+        } break;
+            
+        case EnvCurve::Sine:
+        case EnvCurve::Welch:
+        {
+            mult_[voice] = 0.0;
+            add_[voice] = segment.a2;
+            sign_[voice] = segment.shape == EnvCurve::Sine ? -1.0 : 1.0;
+            k_[voice] = segment.k;
+            y_[voice] = segment.y1;
+            dy_[voice] = segment.dy;
+        } break;
+            
+        default:
+            break;
+    }
+}
+
+void EnvVoiceBank::sync(const int voice) throw()
+{
+    // only the level is needed by the generator to start a new segment
+    generators_[voice].segment_.level = level_[voice];
+}
+
+void EnvVoiceBank::nextSegment(const int voice) throw()
+{
+    EnvGen& generator = generators_[voice];
+    sync(voice);
+    generator.segment_.counter = 0;
+    generator.nextSegment();
+    load(voice);
+}
+
+void EnvVoiceBank::startVoice(const int voice, CompiledEnv const& env, EnvTransform const& transform) throw()
+{
+    assert(voice >= 0 && voice < numVoices_);
+    
+    EnvGen& generator = generators_[voice];
+    generator.setSampleRate(sampleRate_);
+    generator.gate_ = true;
+    generator.setTransform(transform);
+    generator.setEnv(env);
+    load(voice);
+}
+
+void EnvVoiceBank::setGate(const int voice, const bool gate) throw()
+{
+    assert(voice >= 0 && voice < numVoices_);
+    
+    sync(voice);
+    
+    if (generators_[voice].setGate(gate))
+        load(voice);
+}
+
+void EnvVoiceBank::stopVoice(const int voice) throw()
+{
+    assert(voice >= 0 && voice < numVoices_);
+    
+    sync(voice);
+    generators_[voice].finish();
+    load(voice);
+}
+
+void EnvVoiceBank::process(float* const* outputs, const int numSamples) throw()
+{
+    const int numVoices = numVoicesPadded_;
+    double* const level = level_.data();
+    const double* const mult = mult_.data();
+    const double* const add = add_.data();
+    const double* const sign = sign_.data();
+    const double* const k = k_.data();
+    double* const y = y_.data();
+    double* const dy = dy_.data();
+    int64* const counter = counter_.data();
+    
+    int done = 0;
+    
+    while (done < numSamples)
+    {
+        // run all the voices up to the next segment change of any voice
+        int numToProcess = jmin((int) blockSize, numSamples - done);
+        
+        for (int voice = 0; voice < numVoices; ++voice)
+            numToProcess = (int) jmin((int64) numToProcess, counter[voice]);
+        
+        for (int i = 0; i < numToProcess; ++i)
+        {
+            double* const block = block_.data() + i * numVoices;
+            
+            for (int voice = 0; voice < numVoices; ++voice)
+            {
+                block[voice] = level[voice];
+                dy[voice] += k[voice] * y[voice];
+                y[voice] += dy[voice];
+                level[voice] = mult[voice] * level[voice] + add[voice] + sign[voice] * y[voice];
+            }
+        }
+        
+        for (int voice = 0; voice < numVoices; ++voice)
+            counter[voice] -= numToProcess;
+        
+        for (int voice = 0; voice < numVoices_; ++voice)
+        {
+            if (float* const output = outputs[voice])
+            {
+                for (int i = 0; i < numToProcess; ++i)
+                    output[done + i] = (float) block_[i * numVoices + voice];
+            }
+            
+            if (counter[voice] <= 0)
+                nextSegment(voice);
+        }
+        
+        done += numToProcess;
+    }
+}
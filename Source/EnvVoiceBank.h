@@ -0,0 +1,119 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#pragma once
+
+#include "EnvGen.h"
+
+/** Plays many envelopes at once, one per voice.
+ 
+ The per-sample state of every voice is stored in structure-of-arrays form and
+ all the segment shapes are reduced to a single branch-free update:
+ 
+ @code
+ dy += k * y;   y += dy;
+ level = mult * level + add + sign * y;
+ @endcode
+ 
+ Linear, Numerical, Exponential and Step segments are first order (sign is 0)
+ and Sine and Welch segments are second order (mult is 0). The inner loop runs
+ across the voices so it compiles to 2, 4 or 8 voices per instruction with
+ SSE2, AVX or AVX-512. Segment changes, gates, sustain and loops are handled by
+ an EnvGen per voice, only when that voice's segment ends, so the voices behave
+ exactly as EnvGen does.
+ 
+ The state is held in double precision since the Sine and Welch rotations lose
+ their shape in single precision for segments longer than a few hundred samples.
+ 
+ The CompiledEnv objects are not copied and must remain valid while they are
+ used by a voice, the same CompiledEnv can be used by any number of voices.
+ 
+ @ingroup EnvUGens
+ @see EnvGen CompiledEnv */
+class EnvVoiceBank
+{
+public:
+    /** Creates a bank with a fixed number of voices which are all finished. */
+    EnvVoiceBank(const int numVoices, const double sampleRate = 44100.0) throw();
+    
+    inline int getNumVoices() const throw()                     { return numVoices_; }
+    
+    /** Sets the sample rate used by voices started after this call. */
+    void setSampleRate(const double sampleRate) throw();
+    
+    /** Starts a voice from the first level of an envelope with its gate on.
+     @param voice       The voice to start.
+     @param env         The envelope, this is not copied and must remain valid while the voice plays.
+     @param transform   A scaling applied to the levels and times for this voice only. */
+    void startVoice(const int voice, CompiledEnv const& env, EnvTransform const& transform = EnvTransform()) throw();
+    
+    /** Opens or closes the gate of a voice, this takes effect from the next sample. */
+    void setGate(const int voice, const bool gate) throw();
+    
+    /** Stops a voice immediately, holding its current level. */
+    void stopVoice(const int voice) throw();
+    
+    inline bool isFinished(const int voice) const throw()       { return finished_[voice] != 0; }
+    
+    /** Returns one flag per voice which is non-zero once the voice has finished. */
+    inline const uint8* getFinishedFlags() const throw()        { return finished_.data(); }
+    
+    /** Returns the level that a voice's next sample will have. */
+    inline float getLevel(const int voice) const throw()        { return (float) level_[voice]; }
+    
+    /** Writes the next numSamples samples of every voice.
+     @param outputs     One buffer per voice, a null pointer skips writing that voice.
+     @param numSamples  The number of samples to write to each buffer. */
+    void process(float* const* outputs, const int numSamples) throw();
+    
+private:
+    enum { blockSize = 16, voiceAlignment = 16 };
+    
+    void load(const int voice) throw();
+    void sync(const int voice) throw();
+    void nextSegment(const int voice) throw();
+    
+    const int numVoices_;
+    const int numVoicesPadded_;
+    double sampleRate_;
+    
+    std::vector<EnvGen> generators_;
+    std::vector<double> level_, mult_, add_, sign_, k_, y_, dy_;
+    std::vector<int64> counter_;
+    std::vector<uint8> finished_;
+    std::vector<double> block_;
+};
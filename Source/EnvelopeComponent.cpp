@@ -90,7 +90,8 @@ lastY(-1),
 resizeLimits(this),
 shouldLockTime(false),
 shouldLockValue(false),
-ignoreDrag(false)
+ignoreDrag(false),
+polylineNeedsUpdate(true)
 {
     setMouseCursor(MouseCursor::CrosshairCursor);
     resetOffsets();
@@ -203,6 +204,8 @@ void EnvelopeHandleComponent::moved()
 {
     if(dontUpdateTimeAndValue == false)
         updateTimeAndValue();
+    
+    getParentComponent()->handleChanged(this);
 }
 
 void EnvelopeHandleComponent::mouseMove(const MouseEvent& e)
@@ -310,8 +313,8 @@ void EnvelopeHandleComponent::mouseDrag(const MouseEvent& e)
         dragger.dragComponent(this, e, &resizeLimits);
     }
     
+    // moving the handle has already repainted the segments either side of it
     updateLegend();
-    getParentComponent()->repaint();
     getParentComponent()->sendChangeMessage();
     
     if(lastX == getX() && lastY == getY()) {
@@ -407,7 +410,7 @@ void EnvelopeHandleComponent::setTime(double timeToSet)
     
     dontUpdateTimeAndValue = oldDontUpdateTimeAndValue;
     
-    getParentComponent()->repaint();
+    getParentComponent()->handleChanged(this);
     ((EnvelopeComponent*)getParentComponent())->sendChangeMessage();
 }
 
@@ -423,14 +426,15 @@ void EnvelopeHandleComponent::setValue(double valueToSet)
     
     dontUpdateTimeAndValue = oldDontUpdateTimeAndValue;
     
-    getParentComponent()->repaint();
+    getParentComponent()->handleChanged(this);
     ((EnvelopeComponent*)getParentComponent())->sendChangeMessage();
 }
 
 void EnvelopeHandleComponent::setCurve(EnvCurve curveToSet)
 {
     curve = curveToSet;
-    getParentComponent()->repaint();
+    polylineNeedsUpdate = true;
+    getParentComponent()->handleChanged(this);
     ((EnvelopeComponent*)getParentComponent())->sendChangeMessage();
 }
 
@@ -467,7 +471,7 @@ void EnvelopeHandleComponent::setTimeAndValue(double timeToSet, double valueToSe
     
     dontUpdateTimeAndValue = oldDontUpdateTimeAndValue;
     
-    getParentComponent()->repaint();
+    getParentComponent()->handleChanged(this);
     getParentComponent()->sendChangeMessage();
 }
 
@@ -528,7 +532,7 @@ void EnvelopeHandleComponent::recalculatePosition()
     setTopLeftPosition(getParentComponent()->convertDomainToPixels(time),
                        getParentComponent()->convertValueToPixels(value));
     dontUpdateTimeAndValue = oldDontUpdateTimeAndValue;
-    getParentComponent()->repaint();
+    getParentComponent()->handleChanged(this);
 }
 
 
@@ -543,12 +547,15 @@ valueGrid((valueMax-valueMin) / 10),
 domainGrid((domainMax-domainMin) / 16),
 gridDisplayMode(GridNone),
 gridQuantiseMode(GridNone),
+minGridSpacing(6),
 draggingHandle(0),
-curvePoints(64),
+curveTolerance(0.5),
+backgroundScale(1.0f),
 releaseNode(-1),
 loopNode(-1),
 allowCurveEditing(true),
-allowNodeEditing(true)
+allowNodeEditing(true),
+dontSendChangeMessages(false)
 {
     setMouseCursor(MouseCursor::NormalCursor);
     setBounds(0, 0, 200, 200); // non-zero size to start with
@@ -587,7 +594,10 @@ void EnvelopeComponent::setDomainRange(const double min, const double max)
     
     if(changed == true)
     {
+        invalidateBackground();
+        invalidatePolylines();
         recalculateHandles();
+        repaint();
     }
 }
 
@@ -615,7 +625,10 @@ void EnvelopeComponent::setValueRange(const double min, const double max)
     
     if(changed == true)
     {
+        invalidateBackground();
+        invalidatePolylines();
         recalculateHandles();
+        repaint();
     }
 }
 
@@ -633,6 +646,105 @@ void EnvelopeComponent::recalculateHandles()
     }
 }
 
+void EnvelopeComponent::invalidateBackground()
+{
+    backgroundImage = Image();
+}
+
+void EnvelopeComponent::invalidatePolylines()
+{
+    for(int i = 0; i < handles.size(); i++)
+    {
+        handles.getUnchecked(i)->polylineNeedsUpdate = true;
+    }
+}
+
+void EnvelopeComponent::handleChanged(EnvelopeHandleComponent* thisHandle)
+{
+    const int index = handles.indexOf(thisHandle);
+    
+    // not added yet, addHandle() deals with it
+    if(index < 0) return;
+    
+    thisHandle->polylineNeedsUpdate = true;
+    
+    // the curves stay between the levels at either end so each segment is inside the
+    // bounds of its two handles, this handle's old bounds cover where they were drawn
+    Rectangle<int> dirty = thisHandle->getBounds().getUnion(thisHandle->lastBounds);
+    thisHandle->lastBounds = thisHandle->getBounds();
+    
+    if(index > 0)
+        dirty = dirty.getUnion(handles.getUnchecked(index - 1)->getBounds());
+    
+    if(index + 1 < handles.size())
+    {
+        EnvelopeHandleComponent* nextHandle = handles.getUnchecked(index + 1);
+        nextHandle->polylineNeedsUpdate = true;
+        dirty = dirty.getUnion(nextHandle->getBounds());
+    }
+    
+    // allow for the width of the line
+    repaint(dirty.expanded(1));
+    
+    if((index == loopNode) || (index == releaseNode))
+    {
+        const Rectangle<int> loopMarkerBounds = getLoopMarkerBounds();
+        repaint(loopMarkerBounds.getUnion(lastLoopMarkerBounds));
+        lastLoopMarkerBounds = loopMarkerBounds;
+    }
+}
+
+Rectangle<int> EnvelopeComponent::getLoopMarkerBounds() const
+{
+    if((loopNode >= 0) && (releaseNode >= 0) && (releaseNode > loopNode) && (releaseNode < handles.size()))
+    {
+        // the arrow can reach HANDLESIZE*2 to the right of the loop node
+        return handles.getUnchecked(loopNode)->getBounds()
+                    .getUnion(handles.getUnchecked(releaseNode)->getBounds())
+                    .expanded(HANDLESIZE*2);
+    }
+    
+    return Rectangle<int>();
+}
+
+void EnvelopeComponent::updatePolyline(EnvelopeHandleComponent* previousHandle, EnvelopeHandleComponent* thisHandle)
+{
+    // flatten just this segment so nothing else is looked up or copied,
+    // the times are given in pixels so only the levels need converting afterwards
+    const float halfWidth = thisHandle->getWidth()*0.5f;
+    const float halfHeight = thisHandle->getHeight()*0.5f;
+    const double pixelsPerValue = (getHeight() - HANDLESIZE) / (valueMax - valueMin);
+    
+    polylineBuffer.clear();
+    Env::appendSegmentToPolyline(polylineBuffer,
+                                 convertDomainToPixels(previousHandle->getTime()) + halfWidth, previousHandle->getValue(),
+                                 convertDomainToPixels(thisHandle->getTime()) + halfWidth, thisHandle->getValue(),
+                                 thisHandle->getCurve(),
+                                 curveTolerance, 1.0, pixelsPerValue);
+    
+    // the last point is the handle itself which paint() adds
+    Array<Point<float>>& polyline = thisHandle->polyline;
+    polyline.clearQuick();
+    
+    for(int j = 0; j < (int) polylineBuffer.size() - 1; j++)
+    {
+        polyline.add(Point<float>((float) polylineBuffer[j].x,
+                                  (float) convertValueToPixels(polylineBuffer[j].y) + halfHeight));
+    }
+    
+    thisHandle->polylineNeedsUpdate = false;
+}
+
+void EnvelopeComponent::setCurveTolerance(const double pixels)
+{
+    if((pixels > 0.0) && (pixels != curveTolerance))
+    {
+        curveTolerance = pixels;
+        invalidatePolylines();
+        repaint();
+    }
+}
+
 void EnvelopeComponent::setGrid(const GridMode display, const GridMode quantise, const double domainQ, const double valueQ)
 {
     if(quantise != GridLeaveUnchanged)
@@ -641,18 +753,31 @@ void EnvelopeComponent::setGrid(const GridMode display, const GridMode quantise,
     if((display != GridLeaveUnchanged) && (display != gridDisplayMode))
     {
         gridDisplayMode = display;
+        invalidateBackground();
         repaint();
     }
     
     if((domainQ > 0.0) && (domainQ != domainGrid))
     {
         domainGrid = domainQ;
+        invalidateBackground();
         repaint();
     }
     
     if((valueQ > 0.0) && (valueQ != valueGrid))
     {
         valueGrid = valueQ;
+        invalidateBackground();
+        repaint();
+    }
+}
+
+void EnvelopeComponent::setMinGridSpacing(const int pixels)
+{
+    if((pixels > 0) && (pixels != minGridSpacing))
+    {
+        minGridSpacing = pixels;
+        invalidateBackground();
         repaint();
     }
 }
@@ -667,42 +792,46 @@ void EnvelopeComponent::getGrid(GridMode& display, GridMode& quantise, double& d
 
 void EnvelopeComponent::paint(Graphics& g)
 {
-    paintBackground(g);
+    // the background and grid are only drawn again when they change, at the display's resolution
+    const float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    
+    if(backgroundImage.isNull() || (scale != backgroundScale))
+    {
+        backgroundScale = scale;
+        backgroundImage = Image(Image::ARGB,
+                                jmax(1, roundToInt(getWidth() * scale)),
+                                jmax(1, roundToInt(getHeight() * scale)),
+                                true);
+        
+        Graphics imageGraphics(backgroundImage);
+        imageGraphics.addTransform(AffineTransform::scale(scale));
+        paintBackground(imageGraphics);
+    }
+    
+    g.drawImageTransformed(backgroundImage, AffineTransform::scale(1.0f / backgroundScale));
     
     if(handles.size() > 0)
     {
         Path path;
-        Env env = getEnv();
         
         EnvelopeHandleComponent* handle = handles.getUnchecked(0);
         path.startNewSubPath((handle->getX() + handle->getRight()) * 0.5f,
                              (handle->getY() + handle->getBottom()) * 0.5f);
         
-        const float firstTime = handle->getTime();
-        float time = firstTime;
-        
         for(int i = 1; i < handles.size(); i++)
         {
+            EnvelopeHandleComponent* previousHandle = handle;
             handle = handles.getUnchecked(i);
-            float halfWidth = handle->getWidth()*0.5f;
-            float halfHeight = handle->getHeight()*0.5f;
             
-            float nextTime = handle->getTime();
-            float handleTime = nextTime - time;
-            float timeInc = handleTime / curvePoints;
+            // only the segments next to handles which have changed are evaluated again
+            if(handle->polylineNeedsUpdate)
+                updatePolyline(previousHandle, handle);
             
-            for(int j = 0; j < curvePoints; j++)
-            {
-                float value = env.lookup(time - firstTime);
-                path.lineTo(convertDomainToPixels(time) + halfWidth,
-                            convertValueToPixels(value) + halfHeight);
-                time += timeInc;
-            }
+            for(auto const& point : handle->polyline)
+                path.lineTo(point);
             
             path.lineTo((handle->getX() + handle->getRight()) * 0.5f,
                         (handle->getY() + handle->getBottom()) * 0.5f);
-            
-            time = nextTime;
         }
         
         g.setColour(colours[Line]);
@@ -748,37 +877,96 @@ void EnvelopeComponent::paint(Graphics& g)
 }
 
 
+/** Finds the multiple of a grid size to draw so the lines are at least minSpacing apart.
+ The multiples go 1, 2, 5, 10, 20, 50... and majorEvery is set to the number of these
+ lines from one major line to the next, so major lines are at 5 or 10 times the spacing. */
+static double getGridMultiple(const double gridPixels, const double minSpacing, int& majorEvery)
+{
+    static const int mantissas[] = { 1, 2, 5, 10 };
+    
+    double multiple = 1.0;
+    int mantissa = 1;
+    
+    if(gridPixels < minSpacing)
+    {
+        const double needed = minSpacing / gridPixels;
+        const double decade = std::pow(10.0, std::floor(std::log10(needed)));
+        
+        for(int i = 0; i < numElementsInArray(mantissas); i++)
+        {
+            mantissa = mantissas[i];
+            multiple = mantissa * decade;
+            
+            if(multiple >= needed)
+                break;
+        }
+    }
+    
+    majorEvery = (mantissa == 5) ? 2 : 5;
+    return multiple;
+}
+
 void EnvelopeComponent::paintBackground(Graphics& g)
 {
     g.setColour(colours[Background]);
     g.fillRect(0, 0, getWidth(), getHeight());
     
-    g.setColour(colours[GridLine]);
+    // collect the lines so each kind is filled in one go
+    RectangleList<float> minorLines, majorLines;
     
-    if((gridDisplayMode & GridValue) && (valueGrid > 0.0))
+    if((gridDisplayMode & GridValue) && (valueGrid > 0.0) && (valueMax > valueMin))
     {
-        double value = valueMin;
+        const double gridPixels = valueGrid * (getHeight() - HANDLESIZE) / (valueMax - valueMin);
         
-        while(value <= valueMax)
+        if(gridPixels > 0.0)
         {
-            //g.drawHorizontalLine(convertValueToPixels(value) + HANDLESIZE/2, 0, getWidth());
-            float y = convertValueToPixels(value) + HANDLESIZE/2;
-            y = fround(y, 1.f) + 0.5f;
-            g.drawLine(0, y, getWidth(), y, 1.0f);
-            value += valueGrid;
+            int majorEvery;
+            const double step = valueGrid * getGridMultiple(gridPixels, minGridSpacing, majorEvery);
+            
+            // index the lines rather than accumulating so the positions don't drift
+            const int numLines = (int) std::floor((valueMax - valueMin) / step + 1.0e-9);
+            
+            for(int i = 0; i <= numLines; i++)
+            {
+                const float y = fround(convertValueToPixels(valueMin + i * step) + HANDLESIZE/2, 1.f);
+                Rectangle<float> line(0.f, y, (float) getWidth(), 1.f);
+                
+                if(i % majorEvery == 0)
+                    majorLines.addWithoutMerging(line);
+                else
+                    minorLines.addWithoutMerging(line);
+            }
         }
     }
     
-    if((gridDisplayMode & GridDomain) && (domainGrid > 0.0))
+    if((gridDisplayMode & GridDomain) && (domainGrid > 0.0) && (domainMax > domainMin))
     {
-        double domain = domainMin;
+        const double gridPixels = domainGrid * (getWidth() - HANDLESIZE) / (domainMax - domainMin);
         
-        while(domain <= domainMax)
+        if(gridPixels > 0.0)
         {
-            g.drawVerticalLine(convertDomainToPixels(domain) + HANDLESIZE/2, 0, getHeight());
-            domain += domainGrid;
+            int majorEvery;
+            const double step = domainGrid * getGridMultiple(gridPixels, minGridSpacing, majorEvery);
+            const int numLines = (int) std::floor((domainMax - domainMin) / step + 1.0e-9);
+            
+            for(int i = 0; i <= numLines; i++)
+            {
+                const int x = (int) convertDomainToPixels(domainMin + i * step) + HANDLESIZE/2;
+                Rectangle<float> line((float) x, 0.f, 1.f, (float) getHeight());
+                
+                if(i % majorEvery == 0)
+                    majorLines.addWithoutMerging(line);
+                else
+                    minorLines.addWithoutMerging(line);
+            }
         }
     }
+    
+    g.setColour(colours[GridLine].withMultipliedAlpha(0.5f));
+    g.fillRectList(minorLines);
+    
+    g.setColour(colours[GridLine]);
+    g.fillRectList(majorLines);
 }
 
 void EnvelopeComponent::resized()
@@ -786,6 +974,9 @@ void EnvelopeComponent::resized()
 #ifdef MYDEBUG
     printf("MyEnvelopeComponent::resized(%d, %d)\n", getWidth(), getHeight());
 #endif
+    invalidateBackground();
+    invalidatePolylines();
+    
     if(handles.size() != 0) {
         for(int i = 0; i < handles.size(); i++) {
             EnvelopeHandleComponent* handle = handles.getUnchecked(i);
@@ -914,6 +1105,9 @@ void EnvelopeComponent::removeListener (EnvelopeComponentListener* const listene
 
 void EnvelopeComponent::sendChangeMessage()
 {
+    if(dontSendChangeMessages)
+        return;
+    
     for (int i = listeners.size(); --i >= 0;)
     {
         ((EnvelopeComponentListener*) listeners.getUnchecked (i))->envelopeChanged (this);
@@ -1036,13 +1230,21 @@ EnvelopeHandleComponent* EnvelopeComponent::addHandle(double newDomain, double n
         if(releaseNode >= i) releaseNode++;
         if(loopNode >= i) loopNode++;
         
+        // listeners are only told once the handle is in the list
+        bool oldDontSendChangeMessages = dontSendChangeMessages;
+        dontSendChangeMessages = true;
+        
         EnvelopeHandleComponent* handle;
         addAndMakeVisible(handle = new EnvelopeHandleComponent());
         handle->setSize(HANDLESIZE, HANDLESIZE);
         handle->setTimeAndValue(newDomain, newValue, 0.0);
         handle->setCurve(curve);
+        
+        dontSendChangeMessages = oldDontSendChangeMessages;
+        
         handles.insert(i, handle);
-        //    sendChangeMessage();
+        handleChanged(handle);
+        sendChangeMessage();
         return handle;
     }
     else return 0;
@@ -1070,9 +1272,14 @@ void EnvelopeComponent::removeHandle(EnvelopeHandleComponent* thisHandle)
                 loopNode--;
         }
         
+        // the next segment now starts at the previous handle
+        if(index + 1 < handles.size())
+            handles.getUnchecked(index + 1)->polylineNeedsUpdate = true;
+        
         handles.removeFirstMatchingValue(thisHandle);
         removeChildComponent(thisHandle);
         delete thisHandle;
+        lastLoopMarkerBounds = getLoopMarkerBounds();
         sendChangeMessage();
         repaint();
     }
@@ -1121,7 +1328,9 @@ void EnvelopeComponent::setReleaseNode(const int index)
     if((index >= -1) && index < handles.size())
     {
         releaseNode = index;
+        lastLoopMarkerBounds = getLoopMarkerBounds();
         repaint();
+        sendChangeMessage();
     }
 }
 
@@ -1135,7 +1344,9 @@ void EnvelopeComponent::setLoopNode(const int index)
     if((index >= -1) && index < handles.size())
     {
         loopNode = index;
+        lastLoopMarkerBounds = getLoopMarkerBounds();
         repaint();
+        sendChangeMessage();
     }
 }
 
@@ -1211,9 +1422,10 @@ Env EnvelopeComponent::getEnv() const
     double currentLevel = startHandle->getValue();
     double currentTime = startHandle->getTime();
     
-    Buffer levels (handles.size(), 0.0);
-    Buffer times (handles.size()-1, 0.0);
-    EnvCurveList curves (handles.size()-1, EnvCurve::Empty);
+    Env env (handles.size()-1, releaseNode, loopNode);
+    auto levels = env.getLevels();
+    auto times = env.getTimes();
+    auto curves = env.getCurves();
     
     levels[0] = currentLevel;
     
@@ -1231,18 +1443,22 @@ Env EnvelopeComponent::getEnv() const
         currentTime = time;
     }
     
-    return Env(levels, times, curves, releaseNode, loopNode);
+    return env;
 }
 
 void EnvelopeComponent::setEnv(Env const& env)
 {
+    // listeners are told once, when the whole envelope and its nodes are set
+    bool oldDontSendChangeMessages = dontSendChangeMessages;
+    dontSendChangeMessages = true;
+    
     clear();
     
     double time = 0.0;
     
-    const Buffer& levels = env.getLevels();
-    const Buffer& times = env.getTimes();
-    const EnvCurveList& curves = env.getCurves();
+    const auto levels = env.getLevels();
+    const auto times = env.getTimes();
+    const auto curves = env.getCurves();
     
     assert(levels.size() == (times.size()+1));
     
@@ -1258,6 +1474,11 @@ void EnvelopeComponent::setEnv(Env const& env)
     
     releaseNode = env.getReleaseNode();
     loopNode = env.getLoopNode();
+    lastLoopMarkerBounds = getLoopMarkerBounds();
+    repaint();
+    
+    dontSendChangeMessages = oldDontSendChangeMessages;
+    sendChangeMessage();
 }
 
 float EnvelopeComponent::lookup(const float time) const
@@ -1353,6 +1574,9 @@ void EnvelopeComponent::setEnvColour(const EnvColours which, juce::Colour const&
         colours[which] = colour;
         //unlock();
         
+        if((which == Background) || (which == GridLine))
+            invalidateBackground();
+        
         //updateGUI();
         getParentComponent()->repaint();
         repaint();
@@ -1369,6 +1593,34 @@ const juce::Colour& EnvelopeComponent::getEnvColour(const EnvColours which) cons
     return colours[which];
 }
 
+EnvelopeComponentPublisher::EnvelopeComponentPublisher(EnvelopeComponent* _envelope, EnvPublisher& _publisher,
+                                                       const double sampleRate)
+:   envelope(_envelope),
+    publisher(_publisher)
+{
+    if (sampleRate > 0.0)
+        publisher.setSampleRate(sampleRate);
+    
+    envelope->addListener(this);
+    publisher.publish(envelope->getEnv());
+}
+
+EnvelopeComponentPublisher::~EnvelopeComponentPublisher()
+{
+    envelope->removeListener(this);
+}
+
+void EnvelopeComponentPublisher::setSampleRate(const double sampleRate)
+{
+    publisher.setSampleRate(sampleRate);
+    publisher.publish(envelope->getEnv());
+}
+
+void EnvelopeComponentPublisher::envelopeChanged(EnvelopeComponent* changedEnvelope)
+{
+    publisher.publish(changedEnvelope->getEnv());
+}
+
 EnvelopeLegendComponent::EnvelopeLegendComponent(String const& _defaultText)
 :    defaultText(_defaultText)
 {
@@ -42,6 +42,7 @@
 
 #include "JuceHeader.h"
 #include "Env.h"
+#include "EnvPublisher.h"
 
 #define HANDLESIZE 7
 #define FINETUNE 0.001
@@ -117,6 +118,15 @@ private:
     bool dontUpdateTimeAndValue;
     void recalculatePosition();
     
+    /** The points of the segment which ends at this handle, in pixels and not including
+     the handles at either end. This is only rebuilt when polylineNeedsUpdate is set. */
+    Array<Point<float>> polyline;
+    bool polylineNeedsUpdate;
+    
+    /** The bounds when the parent last repainted around this handle, so the area
+     the segments covered before a move can be repainted too. */
+    Rectangle<int> lastBounds;
+    
     ComponentDragger dragger;
     int lastX, lastY;
     int offsetX, offsetY;
@@ -165,6 +175,13 @@ public:
     void setGrid(const GridMode display, const GridMode quantise, const double domain = 0.0, const double value = 0.0);
     void getGrid(GridMode& display, GridMode& quantise, double& domain, double& value) const;
     
+    /** Sets the closest that grid lines are drawn.
+     When the grid lines would be closer than this only every 2nd, 5th, 10th, 20th...
+     line is drawn, so the number of lines is limited by the size of the component
+     rather than by the range and grid size. Quantising still uses the full grid. */
+    void setMinGridSpacing(const int pixels);
+    int getMinGridSpacing() const { return minGridSpacing; }
+    
     void paint(Graphics& g);
     void paintBackground(Graphics& g);
     void resized();
@@ -216,6 +233,17 @@ public:
     double convertDomainToPixels(double domainValue) const;
     double convertValueToPixels(double value) const;
     
+    /** Sets how closely the drawn lines follow curved segments.
+     @param pixels  The largest distance in pixels between the lines and the curve,
+                    smaller values draw smoother curves with more points. */
+    void setCurveTolerance(const double pixels);
+    double getCurveTolerance() const { return curveTolerance; }
+    
+    /** Marks the segments either side of a handle to be redrawn after it changes.
+     This repaints only the area those segments covered before and after the change,
+     and the loop marker if the handle is the loop or release node. */
+    void handleChanged(EnvelopeHandleComponent* thisHandle);
+    
     Env getEnv() const;
     void setEnv(Env const& env);
     float lookup(const float time) const;
@@ -235,6 +263,10 @@ public:
     
 private:
     void recalculateHandles();
+    void invalidateBackground();
+    void invalidatePolylines();
+    Rectangle<int> getLoopMarkerBounds() const;
+    void updatePolyline(EnvelopeHandleComponent* previousHandle, EnvelopeHandleComponent* thisHandle);
     
     SortedSet <void*> listeners;
     Array<EnvelopeHandleComponent*> handles;
@@ -243,16 +275,48 @@ private:
     double valueMin, valueMax;
     double valueGrid, domainGrid;
     GridMode gridDisplayMode, gridQuantiseMode;
+    int minGridSpacing;
     EnvelopeHandleComponent* draggingHandle;
-    int curvePoints;
+    double curveTolerance;
+    EnvPolyline polylineBuffer;
+    Rectangle<int> lastLoopMarkerBounds;
+    Image backgroundImage;          ///< paintBackground() rendered at backgroundScale, null when out of date.
+    float backgroundScale;
     int releaseNode, loopNode;
     
     bool allowCurveEditing:1;
     bool allowNodeEditing:1;
+    bool dontSendChangeMessages:1;  ///< Set while a change is made in several steps, e.g., by setEnv().
     
     juce::Colour colours[NumEnvColours];
 };
 
+/** Publishes the envelope of an EnvelopeComponent to an EnvPublisher whenever it changes.
+ The envelope is compiled on the message thread so an audio thread can take it
+ from the EnvPublisher without calling getEnv() or holding a lock.
+ @ingoup EnvUGens
+ @see EnvPublisher */
+class EnvelopeComponentPublisher : public EnvelopeComponentListener
+{
+public:
+    /** Creates a publisher and publishes the current envelope.
+     @param sampleRate  If greater than zero this is given to EnvPublisher::setSampleRate()
+                        so the sample-accurate functions of the published envelopes can
+                        be used on the audio thread. */
+    EnvelopeComponentPublisher(EnvelopeComponent* envelope, EnvPublisher& publisher,
+                               const double sampleRate = 0.0);
+    ~EnvelopeComponentPublisher();
+    
+    /** Changes the sample rate and publishes the envelope again. */
+    void setSampleRate(const double sampleRate);
+    
+    void envelopeChanged(EnvelopeComponent* changedEnvelope);
+    
+private:
+    EnvelopeComponent* envelope;
+    EnvPublisher& publisher;
+};
+
 class EnvelopeLegendComponent : public Component
 {
 public:
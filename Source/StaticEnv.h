@@ -0,0 +1,298 @@
+// $Id$
+// $HeadURL$
+
+/*
+ ==============================================================================
+ 
+ This file is part of the UGEN++ library
+ Copyright 2008-11 The University of the West of England.
+ by Martin Robinson
+ 
+ ------------------------------------------------------------------------------
+ 
+ UGEN++ can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 2 of the License, or (at your option) any later version.
+ 
+ UGEN++ is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with UGEN++; if not, visit www.gnu.org/licenses or write to the
+ Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ The idea for this project and code in the UGen implementations is
+ derived from SuperCollider which is also released under the 
+ GNU General Public License:
+ 
+ SuperCollider real time audio synthesis system
+ Copyright (c) 2002 James McCartney. All rights reserved.
+ http://www.audiosynth.com
+ 
+ ==============================================================================
+ */
+
+#pragma once
+
+#include "Env.h"
+
+#include <algorithm>
+#include <initializer_list>
+
+/** A fixed-capacity envelope specification which can be built at compile time.
+ 
+ This holds up to MaxSegments segments in plain arrays with no heap storage and
+ its constructor and factories are constexpr so a standard shape, along with its
+ cumulative breakpoint times and the coefficients for any Numerical curves, can be
+ computed by the compiler and placed in read-only data:
+ 
+ @code
+ static constexpr auto pluck = StaticEnv<2>::perc(0.001, 0.4);
+ @endcode
+ 
+ It can be looked up and rendered directly, with the same results as Env, or
+ converted to an Env with toEnv() (which does not allocate for up to
+ Env::numInlineSegments segments).
+ 
+ @ingroup EnvUGens
+ @see Env */
+template <int MaxSegments>
+class StaticEnv
+{
+public:
+    static_assert(MaxSegments > 0, "A StaticEnv needs at least one segment");
+    
+    enum { maxSegments = MaxSegments };
+    
+    /** Creates an envelope from lists of levels, times and curves.
+     If there are fewer curves than times the curves are reused cyclically. Only the
+     first MaxSegments times (and the levels that go with them) are used; in a debug
+     build a longer list asserts, which is a compile error for a constexpr variable. */
+    constexpr StaticEnv(std::initializer_list<double> levels,
+                        std::initializer_list<double> times, /* There should be one fewer time than level. */
+                        std::initializer_list<EnvCurve> curves = { EnvCurve::Linear },
+                        const int releaseNode = -1,
+                        const int loopNode = -1) throw()
+    :   levels_(),
+        times_(),
+        endTimes_(),
+        coefficients_(),
+        curves_(),
+        numSegments_(std::min(std::min((int) times.size(), (int) levels.size() - 1), (int) MaxSegments)),
+        releaseNode_(releaseNode),
+        loopNode_(loopNode)
+    {
+        assert(times.size() <= MaxSegments);
+        assert(levels.size() == times.size() + 1);
+        
+        const int numCurves = (int) curves.size();
+        double time = 0.0;
+        
+        if (numSegments_ < 0)
+        {
+            numSegments_ = 0;
+            return;
+        }
+        
+        levels_[0] = *levels.begin();
+        
+        for (int i = 0; i < numSegments_; ++i)
+        {
+            const EnvCurve curve = numCurves > 0 ? curves.begin()[i % numCurves] : EnvCurve(EnvCurve::Linear);
+            
+            assert(times.begin()[i] >= 0.0);
+            
+            levels_[i + 1] = levels.begin()[i + 1];
+            times_[i] = times.begin()[i];
+            time += times_[i];
+            endTimes_[i] = time;
+            curves_[i] = curve;
+            
+            // as CompiledEnv, a coefficient of zero marks a Numerical curve close enough to linear
+            if (curve.getType() == EnvCurve::Numerical && (curve.getCurve() > 0.001f || curve.getCurve() < -0.001f))
+                coefficients_[i] = 1.0 / (1.0 - exp(curve.getCurve()));
+        }
+    }
+    
+    /// @name Construction of standard shapes
+    /// @{
+    
+    /** Creates a trapezoidal envelope, as Env::linen(). */
+    static constexpr StaticEnv linen(const double attackTime = 1.0,
+                                     const double sustainTime = 2.0,
+                                     const double releaseTime = 1.0,
+                                     const double sustainLevel = 1.0,
+                                     EnvCurve const& curve = EnvCurve::Linear) throw()
+    {
+        return StaticEnv({ 0.0, sustainLevel, sustainLevel, 0.0 },
+                         { attackTime, sustainTime, releaseTime },
+                         { curve });
+    }
+    
+    /** Creates a triangle shaped envelope, as Env::triangle(). */
+    static constexpr StaticEnv triangle(const double duration = 1.0,
+                                        const double level = 1.0) throw()
+    {
+        return StaticEnv({ 0.0, level, 0.0 },
+                         { duration * 0.5, duration * 0.5 });
+    }
+    
+    /** Creates a hanning window shaped envelope, as Env::sine(). */
+    static constexpr StaticEnv sine(const double duration = 1.0,
+                                    const double level = 1.0) throw()
+    {
+        return StaticEnv({ 0.0, level, 0.0 },
+                         { duration * 0.5, duration * 0.5 },
+                         { EnvCurve::Sine });
+    }
+    
+    /** Creates a percussive envelope, as Env::perc(). */
+    static constexpr StaticEnv perc(const double attackTime = 0.01,
+                                    const double releaseTime = 1.0,
+                                    const double level = 1.0,
+                                    EnvCurve const& curve = -4.0f) throw()
+    {
+        return StaticEnv({ 0.0, level, 0.0 },
+                         { attackTime, releaseTime },
+                         { curve });
+    }
+    
+    /** Creates an attack-decay-sustain-release envelope, as Env::adsr(). */
+    static constexpr StaticEnv adsr(const double attackTime = 0.01,
+                                    const double decayTime = 0.3,
+                                    const double sustainLevel = 0.5,
+                                    const double releaseTime = 1.0,
+                                    const double level = 1.0,
+                                    EnvCurve const& curve = -4.0f) throw()
+    {
+        return StaticEnv({ 0.0, level, level * sustainLevel, 0.0 },
+                         { attackTime, decayTime, releaseTime },
+                         { curve }, 2);
+    }
+    
+    /** Creates an attack-sustain-release envelope, as Env::asr(). */
+    static constexpr StaticEnv asr(const double attackTime = 0.01,
+                                   const double sustainLevel = 1.0,
+                                   const double releaseTime = 1.0,
+                                   const double level = 1.0,
+                                   EnvCurve const& curve = -4.0f) throw()
+    {
+        return StaticEnv({ 0.0, level * sustainLevel, 0.0 },
+                         { attackTime, releaseTime },
+                         { curve }, 1);
+    }
+    
+    /// @} <!-- end Construction of standard shapes ------------------------------ -->
+    
+    
+    /// @name Envelope access
+    /// @{
+    
+    constexpr int getNumSegments() const throw()                      { return numSegments_; }
+    constexpr double getLevel(const int index) const throw()          { return levels_[index]; }
+    constexpr double getTime(const int index) const throw()           { return times_[index]; }
+    constexpr double getEndTime(const int index) const throw()        { return endTimes_[index]; }
+    constexpr EnvCurve getCurve(const int segment) const throw()      { return curves_[segment]; }
+    constexpr int getReleaseNode() const throw()                      { return releaseNode_; }
+    constexpr int getLoopNode() const throw()                         { return loopNode_; }
+    
+    /** Returns the sum the time values in the envelope. */
+    constexpr double duration() const throw()                         { return numSegments_ > 0 ? endTimes_[numSegments_ - 1] : 0.0; }
+    
+    /** Returns a copy of this envelope as an Env. */
+    Env toEnv() const throw()
+    {
+        Env env(numSegments_, releaseNode_, loopNode_);
+        
+        std::copy(levels_, levels_ + numSegments_ + 1, env.getLevels().begin());
+        std::copy(times_, times_ + numSegments_, env.getTimes().begin());
+        std::copy(curves_, curves_ + numSegments_, env.getCurves().begin());
+        
+        return env;
+    }
+    
+    /// @} <!-- end Envelope access ------------------------------------------------ -->
+    
+    
+    /** Get the level of the envelope at a given time, as Env::lookup().
+     This ignores the loopNode and releaseNode if they are set. */
+    float lookup(const double time) const throw()
+    {
+        if (time <= 0.0 || numSegments_ == 0)
+            return (float) levels_[0];
+        
+        const int index = (int) (std::lower_bound(endTimes_, endTimes_ + numSegments_, time) - endTimes_);
+        
+        if (index >= numSegments_)
+            return (float) levels_[numSegments_];
+        
+        const double startTime = index > 0 ? endTimes_[index - 1] : 0.0;
+        
+        if (endTimes_[index] == startTime)
+            return (float) levels_[index + 1];
+        
+        const double pos = (time - startTime) / (endTimes_[index] - startTime);
+        const double level0 = levels_[index];
+        const double level1 = levels_[index + 1];
+        
+        if (curves_[index].getType() == EnvCurve::Numerical)
+        {
+            if (coefficients_[index] == 0.0)
+                return (float) (level0 + (level1 - level0) * pos);
+            
+            return (float) (level0 + (level1 - level0) * (1.0 - std::exp(pos * curves_[index].getCurve())) * coefficients_[index]);
+        }
+        
+        return curves_[index].interpolate((float) pos, (float) level0, (float) level1);
+    }
+    
+    /** Write the envelope into a buffer at a given sample rate, as Env::render().
+     This does not allocate any memory and ignores the loopNode and releaseNode if they are set. */
+    void render(float* output, const int numSamples, const double sampleRate, const double startTime = 0.0) const throw()
+    {
+        EnvView(levels_, times_, curves_, numSegments_, releaseNode_, loopNode_).render(output, numSamples, sampleRate, startTime);
+    }
+    
+private:
+    /** A constexpr exp() for curve values. Its relative error is below 2e-13
+     (measured against std::exp() over -30 to 30).
+     The argument is halved until it is small, the Taylor series is summed and
+     the result squared back up. */
+    static constexpr double exp(const double x) throw()
+    {
+        int halvings = 0;
+        double reduced = x;
+        
+        while (reduced > 0.125 || reduced < -0.125)
+        {
+            reduced *= 0.5;
+            ++halvings;
+        }
+        
+        double sum = 1.0;
+        double term = 1.0;
+        
+        for (int n = 1; n < 16; ++n)
+        {
+            term *= reduced / n;
+            sum += term;
+        }
+        
+        while (halvings-- > 0)
+            sum *= sum;
+        
+        return sum;
+    }
+    
+    double levels_[MaxSegments + 1];
+    double times_[MaxSegments];
+    double endTimes_[MaxSegments];
+    double coefficients_[MaxSegments];
+    EnvCurve curves_[MaxSegments];
+    int numSegments_;
+    int releaseNode_;
+    int loopNode_;
+};